@@ -8,125 +8,896 @@
 #include <sstream>
 #include <string>
 #include <limits>
+#include <climits>
+#include <cstdint>
+#include <cassert>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <mutex>
+#include <memory>
+#include <fstream>
+#include <deque>
+#include <set>
+#include <condition_variable>
+#include <cerrno>
+
+#ifdef _MSC_VER
+#include <xmmintrin.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#endif
 
 using namespace std;
 
-// Request class
-class Request {
+// Cache prefetch hint for the line holding address (no effect where unsupported)
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#elif defined(_MSC_VER)
+#define PREFETCH(address) _mm_prefetch((const char*)(address), _MM_HINT_T0)
+#else
+#define PREFETCH(address) ((void)(address))
+#endif
+
+// Heap allocation counters. The instrumentation build (ALLOCATION_ACCOUNTING
+// defined) replaces the global operator new/delete to count every call
+struct AllocationCounts {
+    long long allocations;
+    long long deallocations;
+    long long bytes;
+};
+
+#ifdef ALLOCATION_ACCOUNTING
+atomic<long long> allocation_count(0);
+atomic<long long> deallocation_count(0);
+atomic<long long> allocated_bytes(0);
+
+void* operator new(size_t size) {
+    allocation_count++;
+    allocated_bytes += (long long)size;
+    void* p = malloc(size ? size : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void* p) noexcept {
+    if (!p) return;
+    deallocation_count++;
+    free(p);
+}
+
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+
+const bool allocation_accounting = true;
+
+AllocationCounts getAllocationCounts() {
+    AllocationCounts counts = { allocation_count.load(), deallocation_count.load(), allocated_bytes.load() };
+    return counts;
+}
+#else
+const bool allocation_accounting = false;
+
+AllocationCounts getAllocationCounts() {
+    AllocationCounts counts = { 0, 0, 0 };
+    return counts;
+}
+#endif
+
+// Request handle: 32-bit generational index into RequestTable
+// (low 20 bits - slot index, high 12 bits - slot generation)
+typedef uint32_t RequestHandle;
+const RequestHandle INVALID_REQUEST = 0xFFFFFFFFu;
+
+// Request table (structure of arrays, slots reused through a free list)
+class RequestTable {
+private:
+    static const int INDEX_BITS = 20;
+    static const uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static const uint32_t GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+
+    vector<int> source_ids;
+    vector<int> request_ids;
+    vector<double> arrival_times;
+    vector<double> start_service_times;
+    vector<uint32_t> generations;
+    vector<uint32_t> free_slots;
+
+    static uint32_t indexOf(RequestHandle handle) { return handle & INDEX_MASK; }
+    static uint32_t generationOf(RequestHandle handle) { return handle >> INDEX_BITS; }
+
 public:
-    int source_id;
-    int request_id;
-    double arrival_time;
-    double start_service_time;
-    double finish_service_time;
+    // Room for count live requests without growing
+    void reserve(int count) {
+        source_ids.reserve(count);
+        request_ids.reserve(count);
+        arrival_times.reserve(count);
+        start_service_times.reserve(count);
+        generations.reserve(count);
+        free_slots.reserve(count);
+    }
+
+    // Drop every request, keeping the storage
+    void clear() {
+        source_ids.clear();
+        request_ids.clear();
+        arrival_times.clear();
+        start_service_times.clear();
+        generations.clear();
+        free_slots.clear();
+    }
+
+    RequestHandle create(int src_id, int req_id, double arr_time) {
+        uint32_t index;
+        if (!free_slots.empty()) {
+            index = free_slots.back();
+            free_slots.pop_back();
+        }
+        else {
+            index = (uint32_t)generations.size();
+            // The last index is never handed out, so no handle equals INVALID_REQUEST
+            if (index >= INDEX_MASK) throw length_error("RequestTable: too many live requests");
+            source_ids.push_back(0);
+            request_ids.push_back(0);
+            arrival_times.push_back(0);
+            start_service_times.push_back(0);
+            generations.push_back(0);
+        }
+
+        source_ids[index] = src_id;
+        request_ids[index] = req_id;
+        arrival_times[index] = arr_time;
+        start_service_times[index] = 0;
+        return (generations[index] << INDEX_BITS) | index;
+    }
+
+    // Free the slot; every handle still pointing at it becomes stale
+    void release(RequestHandle handle) {
+        assert(isValid(handle));
+        uint32_t index = indexOf(handle);
+        generations[index] = (generations[index] + 1) & GENERATION_MASK;
+        free_slots.push_back(index);
+    }
+
+    bool isValid(RequestHandle handle) const {
+        uint32_t index = indexOf(handle);
+        return handle != INVALID_REQUEST && index < generations.size() &&
+            generations[index] == generationOf(handle);
+    }
+
+    int getSourceId(RequestHandle handle) const {
+        assert(isValid(handle));
+        return source_ids[indexOf(handle)];
+    }
+
+    int getRequestId(RequestHandle handle) const {
+        assert(isValid(handle));
+        return request_ids[indexOf(handle)];
+    }
+
+    double getArrivalTime(RequestHandle handle) const {
+        assert(isValid(handle));
+        return arrival_times[indexOf(handle)];
+    }
+
+    double getStartServiceTime(RequestHandle handle) const {
+        assert(isValid(handle));
+        return start_service_times[indexOf(handle)];
+    }
+
+    void setStartServiceTime(RequestHandle handle, double time) {
+        assert(isValid(handle));
+        start_service_times[indexOf(handle)] = time;
+    }
+
+    int getLiveCount() const { return (int)(generations.size() - free_slots.size()); }
+};
+
+// SplitMix64 step: expands one seed into well-mixed 64-bit state words
+inline uint64_t splitMix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256++ (Blackman & Vigna): period 2^256 - 1,
+// jump() skips 2^128 draws, longJump() skips 2^192 draws
+class Xoshiro256PlusPlus {
+private:
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    void applyJump(const uint64_t* polynomial) {
+        uint64_t t[4] = { 0, 0, 0, 0 };
+        for (int i = 0; i < 4; i++) {
+            for (int b = 0; b < 64; b++) {
+                if (polynomial[i] & (1ull << b)) {
+                    for (int j = 0; j < 4; j++) t[j] ^= s[j];
+                }
+                (*this)();
+            }
+        }
+        for (int j = 0; j < 4; j++) s[j] = t[j];
+    }
+
+public:
+    typedef uint64_t result_type;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+
+    explicit Xoshiro256PlusPlus(uint64_t seed_value = 1) { seed(seed_value); }
+
+    void seed(uint64_t seed_value) {
+        uint64_t state = seed_value;
+        for (int j = 0; j < 4; j++) s[j] = splitMix64(state);
+    }
+
+    uint64_t getStateWord(int i) const { return s[i]; }
+
+    result_type operator()() {
+        const uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+        const uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    void jump() {
+        static const uint64_t JUMP[] = { 0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull,
+            0xa9582618e03fc9aaull, 0x39abdc4529b1661cull };
+        applyJump(JUMP);
+    }
+
+    void longJump() {
+        static const uint64_t LONG_JUMP[] = { 0x76e15d3efefdcbbfull, 0xc5004e441c522fb3ull,
+            0x77710069854ee241ull, 0x39109bb02acbe635ull };
+        applyJump(LONG_JUMP);
+    }
+};
+
+// Unsigned 128-bit arithmetic (modulo 2^128) for the PCG64 state
+struct UInt128 {
+    uint64_t hi;
+    uint64_t lo;
+
+    UInt128(uint64_t high = 0, uint64_t low = 0) : hi(high), lo(low) {}
+
+    UInt128 operator+(const UInt128& other) const {
+        uint64_t low = lo + other.lo;
+        return UInt128(hi + other.hi + (low < lo ? 1 : 0), low);
+    }
+
+    UInt128 operator*(const UInt128& other) const {
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 product = (unsigned __int128)lo * other.lo;
+        uint64_t high = (uint64_t)(product >> 64);
+        uint64_t low = (uint64_t)product;
+#else
+        // 64 x 64 -> 128 from 32-bit halves
+        uint64_t a0 = (uint32_t)lo, a1 = lo >> 32, b0 = (uint32_t)other.lo, b1 = other.lo >> 32;
+        uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+        uint64_t middle = (p00 >> 32) + (uint32_t)p01 + (uint32_t)p10;
+        uint64_t low = (middle << 32) | (uint32_t)p00;
+        uint64_t high = p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32);
+#endif
+        return UInt128(high + hi * other.lo + lo * other.hi, low);
+    }
+
+    bool isZero() const { return hi == 0 && lo == 0; }
+    bool lowBit() const { return (lo & 1) != 0; }
+    UInt128 halved() const { return UInt128(hi >> 1, (lo >> 1) | (hi << 63)); }
+};
+
+// PCG64 (O'Neill, XSL-RR 128/64): 128-bit LCG state, period 2^128,
+// advance(delta) skips delta draws in O(log delta)
+class Pcg64 {
+private:
+    static UInt128 multiplier() { return UInt128(0x2360ED051FC65DA4ull, 0x4385DF649FCCF645ull); }
+
+    UInt128 state;
+    UInt128 increment;
+
+    void step() { state = state * multiplier() + increment; }
+
+public:
+    typedef uint64_t result_type;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+
+    explicit Pcg64(uint64_t seed_value = 1) { seed(seed_value); }
+
+    void seed(uint64_t seed_value) {
+        uint64_t mix = seed_value;
+        UInt128 initial_state(splitMix64(mix), splitMix64(mix));
+        increment = UInt128(0x5851F42D4C957F2Dull, 0x14057B7EF767814Full);
+        state = UInt128();
+        step();
+        state = state + initial_state;
+        step();
+    }
+
+    result_type operator()() {
+        step();
+        uint64_t folded = state.hi ^ state.lo;
+        int rotation = (int)(state.hi >> 58);
+        return (folded >> rotation) | (folded << ((64 - rotation) & 63));
+    }
+
+    // Brown's algorithm: the LCG applied delta times is again an LCG
+    void advance(UInt128 delta) {
+        UInt128 acc_mult(0, 1), acc_plus;
+        UInt128 cur_mult = multiplier(), cur_plus = increment;
+        while (!delta.isZero()) {
+            if (delta.lowBit()) {
+                acc_mult = acc_mult * cur_mult;
+                acc_plus = acc_plus * cur_mult + cur_plus;
+            }
+            cur_plus = (cur_mult + UInt128(0, 1)) * cur_plus;
+            cur_mult = cur_mult * cur_mult;
+            delta = delta.halved();
+        }
+        state = acc_mult * state + acc_plus;
+    }
+};
+
+// Random stream of one entity (source or device) in one replication, derived
+// from a single master seed. Jumpable engines give every (replication, entity)
+// pair a disjoint subsequence; other engines keep one stream shared by the model
+template <typename Engine>
+struct StreamFactory {
+    static const bool independent_streams = false;
+    static const char* name() { return "default_random_engine"; }
+
+    static Engine make(uint64_t seed, int replication, int /*entity*/) {
+        if (replication == 0) return Engine((typename Engine::result_type)seed);
+        seed_seq seq = { (uint32_t)seed, (uint32_t)(seed >> 32), (uint32_t)replication };
+        return Engine(seq);
+    }
+
+    // Turn the start state of stream (seed, from, entity) into that of (seed, to, entity), to > from
+    static void skipReplications(Engine& start, uint64_t seed, int /*from*/, int to, int entity) {
+        start = make(seed, to, entity);
+    }
+};
+
+template <>
+struct StreamFactory<Xoshiro256PlusPlus> {
+    static const bool independent_streams = true;
+    static const char* name() { return "xoshiro256++"; }
+
+    static const int MAX_CACHED_REPLICATIONS = 4096;
+
+    // Start state of replication r (r long jumps from the seed). The starts of
+    // the last seed are kept per thread, so every stream of a replication, and
+    // each new replication of a run, costs at most one long jump instead of r
+    static Xoshiro256PlusPlus replicationStart(uint64_t seed, int replication) {
+        static thread_local uint64_t cached_seed = 0;
+        static thread_local vector<Xoshiro256PlusPlus> starts;
+        if (starts.empty() || cached_seed != seed) {
+            starts.assign(1, Xoshiro256PlusPlus(seed));
+            cached_seed = seed;
+        }
+        int cached = min(replication, MAX_CACHED_REPLICATIONS);
+        while ((int)starts.size() <= cached) {
+            Xoshiro256PlusPlus next = starts.back();
+            next.longJump();
+            starts.push_back(next);
+        }
+        Xoshiro256PlusPlus gen = starts[cached];
+        for (int i = cached; i < replication; i++) gen.longJump();
+        return gen;
+    }
+
+    // 2^64 replications of 2^192 draws, 2^64 entities of 2^128 draws each
+    static Xoshiro256PlusPlus make(uint64_t seed, int replication, int entity) {
+        Xoshiro256PlusPlus gen = replicationStart(seed, replication);
+        for (int i = 0; i < entity; i++) gen.jump();
+        return gen;
+    }
+
+    static void skipReplications(Xoshiro256PlusPlus& start, uint64_t /*seed*/, int from, int to, int /*entity*/) {
+        for (int i = from; i < to; i++) start.longJump();
+    }
+};
+
+template <>
+struct StreamFactory<Pcg64> {
+    static const bool independent_streams = true;
+    static const char* name() { return "pcg64"; }
+
+    // 2^32 replications of 2^96 draws, 2^32 entities of 2^64 draws each
+    static Pcg64 make(uint64_t seed, int replication, int entity) {
+        Pcg64 gen(seed);
+        gen.advance(UInt128(((uint64_t)(uint32_t)replication << 32) | (uint32_t)entity, 0));
+        return gen;
+    }
+
+    static void skipReplications(Pcg64& start, uint64_t /*seed*/, int from, int to, int /*entity*/) {
+        start.advance(UInt128((uint64_t)(uint32_t)(to - from) << 32, 0));
+    }
+};
+
+// Pseudo-random engine of a model
+enum EngineType {
+    ENGINE_DEFAULT,  // default_random_engine, one stream shared by the model
+    ENGINE_XOSHIRO,  // xoshiro256++, jumped stream per replication and entity
+    ENGINE_PCG       // PCG64, advanced stream per replication and entity
+};
+
+// Interarrival distribution of the sources
+enum ArrivalDistribution {
+    ARRIVALS_UNIFORM,     // variant 6: uniform on [min, max]
+    ARRIVALS_EXPONENTIAL  // Poisson sources with the same mean (exponential variant)
+};
+
+// Sampler used by sources and devices
+enum SamplerType {
+    SAMPLER_STD,      // <random> distributions
+    SAMPLER_ZIGGURAT  // ziggurat exponential, single-multiply uniform conversion
+};
+
+// 64 uniform random bits from any engine (a single call for 64-bit engines)
+template <typename Engine>
+uint64_t randomBits64(Engine& gen) {
+    const uint64_t range = (uint64_t)(Engine::max() - Engine::min());
+    if (range == UINT64_MAX) return (uint64_t)(gen() - Engine::min());
+
+    // Narrower engines: concatenate the full bits of several calls
+    int bits_per_call = 0;
+    while (bits_per_call < 63 && (range >> bits_per_call) > 1) bits_per_call++;
+    const uint64_t mask = (1ull << bits_per_call) - 1;
+
+    uint64_t result = 0;
+    for (int bits = 0; bits < 64; bits += bits_per_call) {
+        result = (result << bits_per_call) | ((uint64_t)(gen() - Engine::min()) & mask);
+    }
+    return result;
+}
+
+// Uniform double in [0, 1) from one engine call and one multiply
+// (uniform_real_distribution goes through generate_canonical instead)
+template <typename Engine>
+double uniformDouble(Engine& gen) {
+    const uint64_t range = (uint64_t)(Engine::max() - Engine::min());
+    if (range == UINT64_MAX) return (double)((uint64_t)(gen() - Engine::min()) >> 11) * 0x1.0p-53;
+    const double scale = 1.0 / ((double)range + 1.0);
+    return (double)(uint64_t)(gen() - Engine::min()) * scale;
+}
+
+// Exponential(1) sampler by the ziggurat method (Marsaglia & Tsang, 256 layers):
+// in ~98.9% of calls the sample costs one 64-bit draw, a compare and a multiply
+class ZigguratExponential {
+private:
+    static const int LAYERS = 256;
+    static constexpr double R = 7.69711747013104972;          // right edge of the base layer
+    static constexpr double V = 3.949659822581572e-3;         // area of every layer
 
-    Request(int src_id, int req_id, double arr_time)
-        : source_id(src_id), request_id(req_id), arrival_time(arr_time),
-        start_service_time(0), finish_service_time(0) {
+    struct Tables {
+        uint64_t k[LAYERS];     // acceptance thresholds: x[i + 1] / x[i] scaled to 2^56
+        double w[LAYERS];       // x[i] / 2^56
+        double f[LAYERS + 1];   // exp(-x[i])
+        double x[LAYERS + 1];   // layer right edges, x[0] - pseudo-width of the base with tail
+
+        Tables() {
+            x[0] = V / exp(-R);
+            x[1] = R;
+            for (int i = 1; i < LAYERS - 1; i++) {
+                x[i + 1] = -log(V / x[i] + exp(-x[i]));
+            }
+            x[LAYERS] = 0;
+
+            for (int i = 0; i <= LAYERS; i++) f[i] = exp(-x[i]);
+            for (int i = 0; i < LAYERS; i++) {
+                k[i] = (uint64_t)(x[i + 1] / x[i] * 0x1.0p56);
+                w[i] = x[i] * 0x1.0p-56;
+            }
+        }
+    };
+
+    static const Tables& tables() {
+        static const Tables instance;
+        return instance;
+    }
+
+public:
+    template <typename Engine>
+    static double sample(Engine& gen) {
+        const Tables& t = tables();
+        while (true) {
+            uint64_t bits = randomBits64(gen);
+            int i = (int)(bits & (LAYERS - 1));
+            uint64_t u = bits >> 8;
+            double x = (double)u * t.w[i];
+
+            // Inside the rectangle fully covered by the density
+            if (u < t.k[i]) return x;
+
+            // Base layer overflow: the tail beyond R is R + Exp(1)
+            if (i == 0) return R + sample(gen);
+
+            // Wedge between the rectangle and the curve
+            double y = t.f[i] + uniformDouble(gen) * (t.f[i + 1] - t.f[i]);
+            if (y < exp(-x)) return x;
+        }
+    }
+};
+
+// Lock-free single-producer single-consumer ring (capacity - power of two)
+template <typename T>
+class SpscRing {
+private:
+    vector<T> slots;
+    size_t mask;
+    alignas(64) atomic<size_t> head; // next slot to read, written by the consumer
+    alignas(64) atomic<size_t> tail; // next slot to write, written by the producer
+
+public:
+    SpscRing(size_t capacity) : slots(capacity), mask(capacity - 1), head(0), tail(0) {
+        assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+    }
+
+    // Producer side: once not full, the ring stays not full until the next push
+    bool isFull() const {
+        return tail.load(memory_order_relaxed) - head.load(memory_order_acquire) == slots.size();
+    }
+
+    bool push(const T& value) {
+        size_t t = tail.load(memory_order_relaxed);
+        if (t - head.load(memory_order_acquire) == slots.size()) return false;
+        slots[t & mask] = value;
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) {
+        size_t h = head.load(memory_order_relaxed);
+        if (h == tail.load(memory_order_acquire)) return false;
+        value = slots[h & mask];
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+};
+
+// Producer thread pre-generating variates of several entities, one ring each.
+// Every entity must own its random stream, so the values it pops are exactly
+// the ones it would have generated inline, whatever the event order
+class VariatePrefetcher {
+private:
+    static const size_t RING_CAPACITY = 1024;
+
+    vector<SpscRing<double>*> rings;
+    vector<function<double()>> generators;
+    atomic<bool> stopping;
+    thread producer;
+
+    void produce() {
+        while (!stopping.load(memory_order_relaxed)) {
+            bool produced = false;
+            for (size_t i = 0; i < rings.size(); i++) {
+                while (!rings[i]->isFull()) {
+                    rings[i]->push(generators[i]());
+                    produced = true;
+                }
+            }
+            if (!produced) this_thread::yield();
+        }
+    }
+
+public:
+    VariatePrefetcher() : stopping(false) {}
+
+    ~VariatePrefetcher() {
+        stopping.store(true);
+        if (producer.joinable()) producer.join();
+        for (auto ring : rings) delete ring;
+    }
+
+    // Register an entity before start(); generate runs on the producer thread only
+    SpscRing<double>* addStream(function<double()> generate) {
+        rings.push_back(new SpscRing<double>(RING_CAPACITY));
+        generators.push_back(generate);
+        return rings.back();
+    }
+
+    void start() {
+        producer = thread(&VariatePrefetcher::produce, this);
+    }
+
+    static double take(SpscRing<double>* ring) {
+        double value;
+        while (!ring->pop(value)) this_thread::yield();
+        return value;
     }
 };
 
+// Start a prefetcher serving every source and device of a model
+template <typename SourceType, typename DeviceType>
+VariatePrefetcher* startPrefetcher(vector<SourceType*>& sources, vector<DeviceType*>& devices) {
+    VariatePrefetcher* prefetcher = new VariatePrefetcher();
+    for (auto source : sources) {
+        source->setPrefetchRing(prefetcher->addStream([source]() { return source->sampleInterval(); }));
+    }
+    for (auto device : devices) {
+        device->setPrefetchRing(prefetcher->addStream([device]() { return device->sampleServiceTime(); }));
+    }
+    prefetcher->start();
+    return prefetcher;
+}
+
 // Source class
-class Source {
+template <typename Engine>
+class BasicSource {
 private:
     uniform_real_distribution<double> dist; // Uniform distribution
-    default_random_engine& generator;
+    exponential_distribution<double> exp_dist; // Exponential variant, same mean
+    Engine& generator;
     int source_id;
+    ArrivalDistribution arrivals;
+    SamplerType sampler;
+    SpscRing<double>* prefetch_ring; // nullptr - generate inline
 
 public:
-    Source(int id, double min_int, double max_int, default_random_engine& gen)
-        : source_id(id), generator(gen), dist(min_int, max_int) {
+    BasicSource(int id, double min_int, double max_int, Engine& gen,
+        SamplerType sampler_type = SAMPLER_STD,
+        ArrivalDistribution arrival_distribution = ARRIVALS_UNIFORM)
+        : dist(min_int, max_int), exp_dist(2.0 / (min_int + max_int)), generator(gen),
+        source_id(id), arrivals(arrival_distribution), sampler(sampler_type),
+        prefetch_ring(nullptr) {
     }
 
-    double getNextInterval() {
+    double sampleInterval() {
+        if (arrivals == ARRIVALS_EXPONENTIAL) {
+            if (sampler == SAMPLER_ZIGGURAT) {
+                return ZigguratExponential::sample(generator) / exp_dist.lambda();
+            }
+            return exp_dist(generator);
+        }
+        if (sampler == SAMPLER_ZIGGURAT) {
+            return dist.a() + (dist.b() - dist.a()) * uniformDouble(generator);
+        }
         return dist(generator);
     }
 
+    double getNextInterval() {
+        if (prefetch_ring) return VariatePrefetcher::take(prefetch_ring);
+        return sampleInterval();
+    }
+
+    void setPrefetchRing(SpscRing<double>* ring) { prefetch_ring = ring; }
+
+    void reset() {
+        dist.reset();
+        exp_dist.reset();
+    }
+
     int getId() const { return source_id; }
 };
 
 // Device class
-class Device {
+template <typename Engine>
+class BasicDevice {
 private:
     exponential_distribution<double> dist; // Exponential distribution
-    default_random_engine& generator;
+    Engine& generator;
+    RequestTable& requests;
     int device_id;
-    Request* current_request;
+    SamplerType sampler;
+    SpscRing<double>* prefetch_ring; // nullptr - generate inline
+    RequestHandle current_request;
 
 public:
-    Device(int id, double mean_time, default_random_engine& gen)
-        : device_id(id), generator(gen), dist(1.0 / mean_time), current_request(nullptr) {
+    BasicDevice(int id, double mean_time, Engine& gen, RequestTable& table,
+        SamplerType sampler_type = SAMPLER_STD)
+        : dist(1.0 / mean_time), generator(gen), requests(table), device_id(id),
+        sampler(sampler_type), prefetch_ring(nullptr), current_request(INVALID_REQUEST) {
     }
 
-    double getServiceTime() {
+    double sampleServiceTime() {
+        if (sampler == SAMPLER_ZIGGURAT) {
+            return ZigguratExponential::sample(generator) / dist.lambda();
+        }
         return dist(generator);
     }
 
-    bool isFree() const { return current_request == nullptr; }
+    double getServiceTime() {
+        if (prefetch_ring) return VariatePrefetcher::take(prefetch_ring);
+        return sampleServiceTime();
+    }
+
+    void setPrefetchRing(SpscRing<double>* ring) { prefetch_ring = ring; }
 
-    void startService(Request* request, double current_time) {
+    bool isFree() const { return current_request == INVALID_REQUEST; }
+
+    void startService(RequestHandle request, double current_time) {
         current_request = request;
-        request->start_service_time = current_time;
+        requests.setStartServiceTime(request, current_time);
     }
 
-    Request* finishService() {
-        Request* finished = current_request;
-        current_request = nullptr;
+    RequestHandle finishService() {
+        RequestHandle finished = current_request;
+        current_request = INVALID_REQUEST;
         return finished;
     }
 
+    RequestHandle getCurrentRequest() const { return current_request; }
+    void setCurrentRequest(RequestHandle request) { current_request = request; }
+
+    void reset() {
+        dist.reset();
+        current_request = INVALID_REQUEST;
+    }
+
     int getId() const { return device_id; }
 };
 
+// Monotonic arena for the objects a model builds once: they are placed one
+// after another in large blocks and destroyed together with the arena
+class MonotonicArena {
+private:
+    static const size_t BLOCK_SIZE = 4096;
+
+    struct Destructor {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    vector<char*> blocks;
+    size_t used; // in the last block
+    size_t block_capacity;
+    vector<Destructor> destructors;
+
+    void* allocate(size_t size, size_t alignment) {
+        size_t offset = (used + alignment - 1) / alignment * alignment;
+        if (blocks.empty() || offset + size > block_capacity) {
+            block_capacity = size + alignment > BLOCK_SIZE ? size + alignment : BLOCK_SIZE;
+            blocks.push_back(static_cast<char*>(::operator new(block_capacity)));
+            used = 0;
+            offset = 0;
+        }
+        used = offset + size;
+        return blocks.back() + offset;
+    }
+
+public:
+    MonotonicArena() : used(0), block_capacity(0) {}
+
+    ~MonotonicArena() {
+        for (auto it = destructors.rbegin(); it != destructors.rend(); ++it) it->destroy(it->object);
+        for (char* block : blocks) ::operator delete(block);
+    }
+
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        T* object = new (allocate(sizeof(T), alignof(T))) T(forward<Args>(args)...);
+        Destructor destructor = { object, [](void* p) { static_cast<T*>(p)->~T(); } };
+        destructors.push_back(destructor);
+        return object;
+    }
+};
+
+// FIFO queue in a ring of preallocated slots: no heap traffic while the size
+// stays within the capacity (doubles when exceeded)
+template <typename T>
+class RingQueue {
+private:
+    vector<T> slots;
+    size_t head;
+    size_t count;
+
+public:
+    RingQueue(size_t capacity = 1) : slots(max<size_t>(1, capacity)), head(0), count(0) {}
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    const T& front() const { return slots[head]; }
+    const T* frontAddress() const { return &slots[head]; } // valid even when empty
+
+    void push(const T& item) {
+        if (count == slots.size()) {
+            vector<T> grown(slots.size() * 2);
+            for (size_t i = 0; i < count; i++) grown[i] = slots[(head + i) % slots.size()];
+            slots.swap(grown);
+            head = 0;
+        }
+        slots[(head + count) % slots.size()] = item;
+        count++;
+    }
+
+    void pop() {
+        head = (head + 1) % slots.size();
+        count--;
+    }
+
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+};
+
 // Buffer class with FIFO discipline
-class Buffer {
+// Entry - stored representation of a request, SourceOf - returns the source id of an entry.
+// The scans rotate the requests through the ring itself (each one is popped
+// and pushed back unless taken), so they never allocate
+template <typename Entry, typename SourceOf>
+class BasicBuffer {
 private:
-    queue<Request*> buffer;
+    RingQueue<Entry> buffer;
+    SourceOf source_of;
     int max_size;
 
 public:
-    Buffer(int size) : max_size(size) {}
+    BasicBuffer(int size, SourceOf src_of) : buffer(size + 1), source_of(src_of), max_size(size) {}
 
     bool isFull() const { return buffer.size() >= max_size; }
     bool isEmpty() const { return buffer.empty(); }
     int getSize() const { return (int)buffer.size(); }
     int getMaxSize() const { return max_size; }
+    const Entry* getHeadAddress() const { return buffer.frontAddress(); }
+
+    const RingQueue<Entry>& getContents() const { return buffer; }
+    void setContents(const RingQueue<Entry>& contents) { buffer = contents; }
+
+    void clear() { buffer.clear(); }
 
     // Add request to buffer (FIFO)
-    void addRequest(Request* request) {
+    void addRequest(const Entry& request) {
         buffer.push(request);
     }
 
-    // Get next request with packet service discipline
-    Request* getNextRequest(int& current_serving_source) {
+    // Get next request with packet service discipline (taken out of the buffer)
+    bool getNextRequest(int& current_serving_source, Entry& next_request) {
         if (buffer.empty()) {
             current_serving_source = -1;
-            return nullptr;
+            return false;
         }
 
         // If current packet exists, find request from this source
         if (current_serving_source != -1) {
-            queue<Request*> temp;
-            Request* found = nullptr;
+            bool found = false;
 
-            while (!buffer.empty()) {
-                Request* req = buffer.front();
+            for (size_t n = buffer.size(); n > 0; n--) {
+                Entry req = buffer.front();
                 buffer.pop();
-                if (req->source_id == current_serving_source && found == nullptr) {
-                    found = req;
+                if (source_of(req) == current_serving_source && !found) {
+                    next_request = req;
+                    found = true;
                 }
                 else {
-                    temp.push(req);
+                    buffer.push(req);
                 }
             }
 
-            while (!temp.empty()) {
-                buffer.push(temp.front());
-                temp.pop();
-            }
-
             if (found) {
-                return found;
+                return true;
             }
             else {
                 current_serving_source = -1;
@@ -135,85 +906,81 @@ public:
 
         if (buffer.empty()) {
             current_serving_source = -1;
-            return nullptr;
+            return false;
         }
 
-        queue<Request*> temp;
-        Request* best_request = nullptr;
+        bool has_best = false;
         int best_source = INT_MAX;
 
-        while (!buffer.empty()) {
-            Request* req = buffer.front();
+        for (size_t n = buffer.size(); n > 0; n--) {
+            Entry req = buffer.front();
             buffer.pop();
-            if (req->source_id < best_source) {
-                if (best_request) temp.push(best_request);
-                best_source = req->source_id;
-                best_request = req;
+            if (source_of(req) < best_source) {
+                if (has_best) buffer.push(next_request);
+                best_source = source_of(req);
+                next_request = req;
+                has_best = true;
             }
             else {
-                temp.push(req);
+                buffer.push(req);
             }
         }
 
-        while (!temp.empty()) {
-            buffer.push(temp.front());
-            temp.pop();
-        }
-
-        if (best_request) {
+        if (has_best) {
             current_serving_source = best_source;
         }
 
-        return best_request;
+        return has_best;
     }
 
-    // Find request to reject (from source with highest number)
-    Request* findRequestToReject() {
-        if (buffer.empty()) return nullptr;
+    // Find request to reject (from source with highest number), taken out of the buffer
+    bool findRequestToReject(Entry& worst_request) {
+        if (buffer.empty()) return false;
 
-        queue<Request*> temp;
-        Request* worst_request = nullptr;
+        bool has_worst = false;
         int worst_source = -1;
 
-        while (!buffer.empty()) {
-            Request* req = buffer.front();
+        for (size_t n = buffer.size(); n > 0; n--) {
+            Entry req = buffer.front();
             buffer.pop();
-            if (req->source_id > worst_source) {
-                if (worst_request) temp.push(worst_request);
-                worst_source = req->source_id;
+            if (source_of(req) > worst_source) {
+                if (has_worst) buffer.push(worst_request);
+                worst_source = source_of(req);
                 worst_request = req;
+                has_worst = true;
             }
             else {
-                temp.push(req);
+                buffer.push(req);
             }
         }
 
-        while (!temp.empty()) {
-            buffer.push(temp.front());
-            temp.pop();
-        }
-
-        return worst_request;
+        return has_worst;
     }
 
-    void removeRequest(Request* request) {
-        queue<Request*> temp;
-
-        while (!buffer.empty()) {
-            Request* req = buffer.front();
+    void removeRequest(const Entry& request) {
+        for (size_t n = buffer.size(); n > 0; n--) {
+            Entry req = buffer.front();
             buffer.pop();
             if (req != request) {
-                temp.push(req);
+                buffer.push(req);
             }
         }
-
-        while (!temp.empty()) {
-            buffer.push(temp.front());
-            temp.pop();
-        }
     }
 };
 
+// Source id lookup for a buffer of request handles
+class RequestSourceOf {
+private:
+    const RequestTable* requests;
+
+public:
+    RequestSourceOf(const RequestTable& table) : requests(&table) {}
+
+    int operator()(RequestHandle request) const { return requests->getSourceId(request); }
+};
+
+typedef BasicBuffer<RequestHandle, RequestSourceOf> Buffer;
+
 // Device selector with round-robin discipline
 class DeviceSelector {
 private:
@@ -223,7 +990,11 @@ private:
 public:
     DeviceSelector(int num_devs) : last_used(-1), num_devices(num_devs) {}
 
-    Device* getFreeDevice(vector<Device*>& devices) {
+    int getLastUsed() const { return last_used; }
+    void setLastUsed(int device_id) { last_used = device_id; }
+
+    template <typename DeviceType>
+    DeviceType* getFreeDevice(vector<DeviceType*>& devices) {
         if (devices.empty()) return nullptr;
 
         int start_index = (last_used + 1) % num_devices;
@@ -239,193 +1010,694 @@ public:
     }
 };
 
-// Event class
+// Event class (16 bytes: departures carry the request handle, arrivals do not,
+// so the event type is derived from the handle instead of being stored)
 class Event {
 public:
+    enum Type { ARRIVAL, DEPARTURE };
+
     double time;
-    enum Type { ARRIVAL, DEPARTURE } type;
     int entity_id;
-    Request* request;
+    RequestHandle request;
 
-    Event(double t, Type tp, int id, Request* req = nullptr)
-        : time(t), type(tp), entity_id(id), request(req) {
+    Event(double t, Type tp, int id, RequestHandle req = INVALID_REQUEST)
+        : time(t), entity_id(id), request(req) {
+        assert((tp == DEPARTURE) == (req != INVALID_REQUEST));
     }
 
+    Type getType() const { return request == INVALID_REQUEST ? ARRIVAL : DEPARTURE; }
+
     bool operator>(const Event& other) const {
         return time > other.time;
     }
 };
 
-// Main simulation model
-class SimulationModel {
-private:
-    priority_queue<Event, vector<Event>, greater<Event>> calendar;
-    vector<Source*> sources;
-    vector<Device*> devices;
-    Buffer* buffer;
-    DeviceSelector* device_selector;
-    default_random_engine generator;
-
-    double current_time;
-    int current_serving_source;
-    int requests_generated;
-    int requests_served;
-    int requests_rejected;
+// Model parameters (defaults - variant 6)
+struct ModelConfig {
+    vector<double> source_min_intervals;
+    vector<double> source_max_intervals;
+    vector<double> device_mean_times;
+    int buffer_size;
+    unsigned seed; // 0 - seed from random_device
+    int replication;
+    EngineType engine;
+    SamplerType sampler;
+    bool prefetch; // producer thread pre-generates variates (needs per-entity streams)
+    ArrivalDistribution arrivals;
+    double window_length; // tumbling rate window, see WindowCounters
+    int window_buckets;   // tumbling windows per sliding window
+    bool perf_counters;   // hardware counters around run() (Linux)
 
-    vector<int> source_requests;
-    vector<int> source_rejections;
-    vector<double> source_total_time;
-    vector<double> source_waiting_time;
-    vector<double> device_busy_time;
-
-public:
-    SimulationModel() : current_time(0), current_serving_source(-1),
-        requests_generated(0), requests_served(0), requests_rejected(0) {
-
-        random_device rd;
-        generator.seed(rd());
-
-        // Create sources
+    ModelConfig() : buffer_size(3), seed(0), replication(0), engine(ENGINE_DEFAULT),
+        sampler(SAMPLER_STD), prefetch(false), arrivals(ARRIVALS_UNIFORM),
+        window_length(100.0), window_buckets(10), perf_counters(false) {
         int num_sources = 3;
         for (int i = 0; i < num_sources; i++) {
-            double min_interval = 1.5 + i * 0.5;
-            double max_interval = 2.5 + i * 0.5;
-            sources.push_back(new Source(i, min_interval, max_interval, generator));
+            source_min_intervals.push_back(1.5 + i * 0.5);
+            source_max_intervals.push_back(2.5 + i * 0.5);
         }
 
-        // Create devices
-        int num_devices = 2;
-        for (int i = 0; i < num_devices; i++) {
-            double mean_time = 2.0 + i * 1.0;
-            devices.push_back(new Device(i, mean_time, generator));
+        setNumDevices(2);
+    }
+
+    // Devices added beyond the current count follow the variant's pattern
+    void setNumDevices(int num_devices) {
+        for (int i = getNumDevices(); i < num_devices; i++) {
+            device_mean_times.push_back(2.0 + i * 1.0);
         }
+        device_mean_times.resize(num_devices);
+    }
 
-        buffer = new Buffer(3);
-        device_selector = new DeviceSelector(num_devices);
+    int getNumSources() const { return (int)source_min_intervals.size(); }
+    int getNumDevices() const { return (int)device_mean_times.size(); }
 
-        source_requests.resize(num_sources, 0);
-        source_rejections.resize(num_sources, 0);
-        source_total_time.resize(num_sources, 0);
-        source_waiting_time.resize(num_sources, 0);
-        device_busy_time.resize(num_devices, 0);
+    unsigned resolveSeed() const {
+        if (seed != 0) return seed;
+        random_device rd;
+        return rd();
+    }
+};
 
-        for (int i = 0; i < num_sources; i++) {
-            double first_time = sources[i]->getNextInterval();
-            calendar.push(Event(first_time, Event::ARRIVAL, i));
-        }
+// Markov state of the exponential variant (what the perfect sampler produces)
+struct SystemState {
+    vector<int> buffer_counts; // requests waiting in the buffer, by source
+    vector<bool> device_busy;
+    int last_used_device;       // round-robin pointer
+    int current_serving_source; // packet being served, -1 - none
+};
+
+// Random streams of one model: a single shared stream, or one per source
+// (entities 0..S-1) and device (entities S..S+D-1) for jumpable engines
+template <typename Engine>
+vector<Engine> makeModelStreams(const ModelConfig& config) {
+    uint64_t seed = config.resolveSeed();
+    int num_streams = StreamFactory<Engine>::independent_streams ?
+        config.getNumSources() + config.getNumDevices() : 1;
+
+    vector<Engine> streams;
+    for (int i = 0; i < num_streams; i++) {
+        streams.push_back(StreamFactory<Engine>::make(seed, config.replication, i));
     }
+    return streams;
+}
 
-    ~SimulationModel() {
-        for (auto source : sources) delete source;
-        for (auto device : devices) delete device;
-        delete buffer;
-        delete device_selector;
+// Re-seed the streams of makeModelStreams in place (entities keep references to them)
+template <typename Engine>
+void reseedModelStreams(vector<Engine>& streams, const ModelConfig& config) {
+    uint64_t seed = config.resolveSeed();
+    for (size_t i = 0; i < streams.size(); i++) {
+        streams[i] = StreamFactory<Engine>::make(seed, config.replication, (int)i);
     }
+}
 
-    void processArrival(int source_id) {
-        requests_generated++;
-        source_requests[source_id]++;
-        Request* request = new Request(source_id, source_requests[source_id], current_time);
+// Time-weighted histogram of an integer state variable (time spent at each
+// value). Updated only when the value changes: O(1), amortized when the value
+// exceeds every previous one (never once reserve() covers the range)
+class TimeWeightedHistogram {
+private:
+    vector<double> time_at;
+    int value;
+    int max_value; // since the last restart
+    double last_time;
 
-        double next_time = current_time + sources[source_id]->getNextInterval();
-        calendar.push(Event(next_time, Event::ARRIVAL, source_id));
+public:
+    TimeWeightedHistogram(double start = 0) : time_at(1, 0), value(0), max_value(0), last_time(start) {}
 
-        Device* free_device = device_selector->getFreeDevice(devices);
-        if (free_device) {
-            double service_time = free_device->getServiceTime();
-            free_device->startService(request, current_time);
-            calendar.push(Event(current_time + service_time, Event::DEPARTURE,
-                free_device->getId(), request));
+    void reserve(int max_expected) {
+        if (max_expected >= (int)time_at.size()) time_at.resize(max_expected + 1, 0);
+    }
+
+    void add(double time, int delta) {
+        time_at[value] += time - last_time;
+        last_time = time;
+        value += delta;
+        if (value >= (int)time_at.size()) time_at.resize(value + 1, 0);
+        max_value = max(max_value, value);
+    }
+
+    // Drop the accumulated times but keep the current value (end of a warm-up)
+    void restart(double time) {
+        fill(time_at.begin(), time_at.end(), 0);
+        max_value = value;
+        last_time = time;
+    }
+
+    // Empty state at time start, keeping the storage
+    void reset(double start) {
+        value = 0;
+        restart(start);
+    }
+
+    // Add the distribution of another replication observed up to other_time
+    void merge(const TimeWeightedHistogram& other, double other_time) {
+        vector<double> other_times = other.getTimes(other_time);
+        if (other_times.size() > time_at.size()) time_at.resize(other_times.size(), 0);
+        for (size_t k = 0; k < other_times.size(); k++) time_at[k] += other_times[k];
+        max_value = max(max_value, other.max_value);
+    }
+
+    int getValue() const { return value; }
+    int getMaxValue() const { return max_value; }
+
+    // Times at each value, including the open interval up to current_time
+    vector<double> getTimes(double current_time) const {
+        vector<double> times = time_at;
+        if (current_time > last_time) times[value] += current_time - last_time;
+        return times;
+    }
+
+    vector<double> getProbabilities(double current_time) const {
+        vector<double> probabilities = getTimes(current_time);
+        double total = 0;
+        for (double t : probabilities) total += t;
+        for (double& p : probabilities) p = total > 0 ? p / total : 0;
+        return probabilities;
+    }
+
+    double getMean(double current_time) const {
+        vector<double> probabilities = getProbabilities(current_time);
+        double mean = 0;
+        for (size_t k = 0; k < probabilities.size(); k++) mean += k * probabilities[k];
+        return mean;
+    }
+
+    // Smallest value with P(X <= value) >= q
+    int getQuantile(double q, double current_time) const {
+        vector<double> probabilities = getProbabilities(current_time);
+        double cumulative = 0;
+        for (size_t k = 0; k < probabilities.size(); k++) {
+            cumulative += probabilities[k];
+            if (cumulative >= q - 1e-12) return (int)k;
         }
-        else {
-            if (!buffer->isFull()) {
-                buffer->addRequest(request);
+        return getMaxValue();
+    }
+
+    bool operator==(const TimeWeightedHistogram& other) const {
+        // Reserved ranges may differ: values past the shorter one must be unvisited
+        size_t common = min(time_at.size(), other.time_at.size());
+        for (size_t k = common; k < time_at.size(); k++) if (time_at[k] != 0) return false;
+        for (size_t k = common; k < other.time_at.size(); k++) if (other.time_at[k] != 0) return false;
+        return equal(time_at.begin(), time_at.begin() + common, other.time_at.begin()) &&
+            value == other.value && max_value == other.max_value && last_time == other.last_time;
+    }
+};
+
+// Per-source counts of arrivals, served requests and rejections in tumbling
+// windows of window_length; the last num_buckets windows form the sliding
+// window. O(1) per event (per source when a window closes), memory bounded
+// by num_buckets. Only complete windows are evaluated
+class WindowCounters {
+public:
+    enum Kind { ARRIVED, SERVED, REJECTED, NUM_KINDS };
+
+    // Extremes over the closed windows of one source
+    struct Peaks {
+        int max_rejections;          // tumbling window
+        double max_rejections_start; // start of that window
+        double max_reject_prob;      // rejected / (rejected + served), tumbling window
+        int min_served;
+        int max_sliding_rejections;
+        double max_sliding_end;
+        double max_sliding_reject_prob;
+    };
+
+private:
+    double start_time;
+    double window_length;
+    int num_buckets;
+    int num_sources;
+    long long current_window;
+    long long closed_windows;
+    vector<int> buckets; // [bucket][source][kind], bucket = window % (num_buckets + 1)
+    vector<int> sliding; // [source][kind], sum over the last num_buckets closed windows
+    vector<Peaks> peaks;
+
+    int& count(long long window, int source_id, int kind) {
+        return buckets[((window % (num_buckets + 1)) * num_sources + source_id) * NUM_KINDS + kind];
+    }
+
+    // Share of the requests that left in a window which were rejected
+    static double rejectProb(int rejected, int served) {
+        return rejected + served > 0 ? (double)rejected / (rejected + served) : 0;
+    }
+
+    void closeWindow() {
+        double window_start = start_time + current_window * window_length;
+        closed_windows++;
+        for (int i = 0; i < num_sources; i++) {
+            Peaks& p = peaks[i];
+            int served = count(current_window, i, SERVED);
+            int rejected = count(current_window, i, REJECTED);
+            if (rejected > p.max_rejections) {
+                p.max_rejections = rejected;
+                p.max_rejections_start = window_start;
             }
-            else {
-                Request* rejected_request = buffer->findRequestToReject();
-                if (rejected_request) {
-                    source_rejections[rejected_request->source_id]++;
-                    requests_rejected++;
-                    buffer->removeRequest(rejected_request);
-                    delete rejected_request;
+            p.max_reject_prob = max(p.max_reject_prob, rejectProb(rejected, served));
+            p.min_served = (closed_windows == 1) ? served : min(p.min_served, served);
+
+            // The window num_buckets back leaves the sliding window; its bucket
+            // is reused by the next window
+            for (int kind = 0; kind < NUM_KINDS; kind++) {
+                sliding[i * NUM_KINDS + kind] += count(current_window, i, kind);
+                if (closed_windows > num_buckets) {
+                    sliding[i * NUM_KINDS + kind] -= count(current_window + 1, i, kind);
                 }
-                buffer->addRequest(request);
+            }
+            if (closed_windows >= num_buckets) {
+                int sliding_rejected = sliding[i * NUM_KINDS + REJECTED];
+                if (sliding_rejected > p.max_sliding_rejections) {
+                    p.max_sliding_rejections = sliding_rejected;
+                    p.max_sliding_end = window_start + window_length;
+                }
+                p.max_sliding_reject_prob = max(p.max_sliding_reject_prob,
+                    rejectProb(sliding_rejected, sliding[i * NUM_KINDS + SERVED]));
             }
         }
+        current_window++;
+        for (int i = 0; i < num_sources; i++) {
+            for (int kind = 0; kind < NUM_KINDS; kind++) count(current_window, i, kind) = 0;
+        }
     }
 
-    void processDeparture(int device_id) {
-        Device* device = devices[device_id];
-        Request* finished_request = device->finishService();
+public:
+    WindowCounters(int sources = 0, double start = 0, double length = 100.0, int window_buckets = 10)
+        : start_time(start), window_length(length), num_buckets(max(1, window_buckets)),
+        num_sources(sources), current_window(0), closed_windows(0),
+        buckets((num_buckets + 1) * sources * NUM_KINDS, 0), sliding(sources * NUM_KINDS, 0),
+        peaks(sources, Peaks{ 0, 0, 0, 0, 0, 0, 0 }) {
+    }
 
-        if (finished_request) {
-            requests_served++;
-            finished_request->finish_service_time = current_time;
+    // Back to the first window at start, keeping the storage
+    void reset(double start) {
+        start_time = start;
+        current_window = 0;
+        closed_windows = 0;
+        fill(buckets.begin(), buckets.end(), 0);
+        fill(sliding.begin(), sliding.end(), 0);
+        fill(peaks.begin(), peaks.end(), Peaks{ 0, 0, 0, 0, 0, 0, 0 });
+    }
 
-            double total_time = finished_request->finish_service_time -
-                finished_request->arrival_time;
-            double waiting_time = finished_request->start_service_time -
-                finished_request->arrival_time;
+    void record(int source_id, Kind kind, double time) {
+        long long window = (long long)((time - start_time) / window_length);
+        int empty_closed = -1; // the first window closed is the current one
+        while (current_window < window) {
+            closeWindow();
+            // After num_buckets empty windows all buckets and sliding sums are
+            // zero, so the remaining empty windows change nothing but the count
+            if (++empty_closed >= num_buckets) {
+                closed_windows += window - current_window;
+                current_window = window;
+            }
+        }
+        count(current_window, source_id, kind)++;
+    }
 
-            source_total_time[finished_request->source_id] += total_time;
-            source_waiting_time[finished_request->source_id] += waiting_time;
-            device_busy_time[device_id] += (finished_request->finish_service_time -
-                finished_request->start_service_time);
+    double getWindowLength() const { return window_length; }
+    int getBuckets() const { return num_buckets; }
+    long long getClosedWindows() const { return closed_windows; }
+    const Peaks& getPeaks(int source_id) const { return peaks[source_id]; }
 
-            delete finished_request;
-        }
+    bool operator==(const WindowCounters& other) const {
+        return start_time == other.start_time && window_length == other.window_length &&
+            num_buckets == other.num_buckets && current_window == other.current_window &&
+            closed_windows == other.closed_windows && buckets == other.buckets &&
+            sliding == other.sliding && equal(peaks.begin(), peaks.end(), other.peaks.begin(),
+                other.peaks.end(), [](const Peaks& a, const Peaks& b) {
+                    return a.max_rejections == b.max_rejections &&
+                        a.max_rejections_start == b.max_rejections_start &&
+                        a.max_reject_prob == b.max_reject_prob && a.min_served == b.min_served &&
+                        a.max_sliding_rejections == b.max_sliding_rejections &&
+                        a.max_sliding_end == b.max_sliding_end &&
+                        a.max_sliding_reject_prob == b.max_sliding_reject_prob;
+                });
+    }
+};
 
-        if (!buffer->isEmpty()) {
-            Request* next_request = buffer->getNextRequest(current_serving_source);
-            if (next_request) {
-                buffer->removeRequest(next_request);
+// Packet service accounting. A packet is the run of requests taken from the
+// buffer while current_serving_source names the same source; it lasts from its
+// first dispatch until another source's packet starts. O(1) per dispatch
+class PacketStatistics {
+private:
+    int current_source; // -1 - no packet yet
+    double packet_start;
+    long long packet_length;
 
-                Device* free_device = device_selector->getFreeDevice(devices);
-                if (free_device) {
-                    double service_time = free_device->getServiceTime();
-                    free_device->startService(next_request, current_time);
-                    calendar.push(Event(current_time + service_time, Event::DEPARTURE,
-                        free_device->getId(), next_request));
-                }
+    vector<long long> packets;     // closed packets, by source
+    vector<long long> dispatched;  // requests in closed packets
+    vector<long long> max_length;
+    vector<double> total_duration;
+    vector<double> max_duration;
+    long long switches;            // packets closed by another source's packet
+
+public:
+    PacketStatistics(int num_sources = 0, double start = 0)
+        : current_source(-1), packet_start(start), packet_length(0),
+        packets(num_sources, 0), dispatched(num_sources, 0), max_length(num_sources, 0),
+        total_duration(num_sources, 0), max_duration(num_sources, 0), switches(0) {
+    }
+
+    // No packet yet, counted from start; keeps the storage
+    void reset(double start) {
+        current_source = -1;
+        packet_start = start;
+        packet_length = 0;
+        fill(packets.begin(), packets.end(), 0);
+        fill(dispatched.begin(), dispatched.end(), 0);
+        fill(max_length.begin(), max_length.end(), 0);
+        fill(total_duration.begin(), total_duration.end(), 0);
+        fill(max_duration.begin(), max_duration.end(), 0);
+        switches = 0;
+    }
+
+    // Keep the packet in service but count it from time (end of a warm-up)
+    void restart(int num_sources, double time) {
+        int source = current_source;
+        *this = PacketStatistics(num_sources, time);
+        current_source = source;
+    }
+
+    // A request from serving_source was taken out of the buffer at time
+    void recordDispatch(int serving_source, double time) {
+        if (serving_source != current_source) {
+            if (current_source != -1) {
+                double duration = time - packet_start;
+                packets[current_source]++;
+                dispatched[current_source] += packet_length;
+                max_length[current_source] = max(max_length[current_source], packet_length);
+                total_duration[current_source] += duration;
+                max_duration[current_source] = max(max_duration[current_source], duration);
+                switches++;
             }
+            current_source = serving_source;
+            packet_start = time;
+            packet_length = 0;
         }
+        packet_length++;
     }
 
-    void run(double max_time = 1000.0, int max_requests = 1000) {
-        cout << "=== SIMULATION MODEL VARIANT 6 ===" << endl;
-        cout << "DISCIPLINES:" << endl;
-        cout << "- Infinite sources" << endl;
-        cout << "- Uniform request distribution" << endl;
-        cout << "- Exponential service time" << endl;
-        cout << "- FIFO buffering" << endl;
-        cout << "- Rejection by source priority" << endl;
-        cout << "- Packet service" << endl;
-        cout << "- Round-robin device selection" << endl;
-        cout << "Parameters: " << sources.size() << " sources, "
-            << devices.size() << " devices, buffer: " << buffer->getMaxSize() << endl;
-        cout << "Max time: " << max_time << " units" << endl;
-        cout << "Max requests: " << max_requests << endl;
-        cout << "----------------------------------------" << endl;
+    long long getSwitches() const { return switches; }
+    long long getPackets(int source_id) const { return packets[source_id]; }
+    long long getMaxLength(int source_id) const { return max_length[source_id]; }
+    double getMaxDuration(int source_id) const { return max_duration[source_id]; }
 
-        while (!calendar.empty() && current_time < max_time &&
-            requests_served < max_requests) {
+    double getAverageLength(int source_id) const {
+        return packets[source_id] > 0 ? (double)dispatched[source_id] / packets[source_id] : 0;
+    }
 
-            Event event = calendar.top();
-            calendar.pop();
-            current_time = event.time;
+    double getAverageDuration(int source_id) const {
+        return packets[source_id] > 0 ? total_duration[source_id] / packets[source_id] : 0;
+    }
 
-            if (event.type == Event::ARRIVAL) {
-                processArrival(event.entity_id);
-            }
-            else if (event.type == Event::DEPARTURE) {
-                processDeparture(event.entity_id);
+    // Share of the buffer dispatches (closed packets) taken by the source
+    double getDispatchShare(int source_id) const {
+        long long total = 0;
+        for (long long count : dispatched) total += count;
+        return total > 0 ? (double)dispatched[source_id] / total : 0;
+    }
+
+    bool operator==(const PacketStatistics& other) const {
+        return current_source == other.current_source && packet_start == other.packet_start &&
+            packet_length == other.packet_length && packets == other.packets &&
+            dispatched == other.dispatched && max_length == other.max_length &&
+            total_duration == other.total_duration && max_duration == other.max_duration &&
+            switches == other.switches;
+    }
+};
+
+// Two-sided 95% quantile of Student's t (Cornish-Fisher expansion, within
+// 0.1% for df >= 5)
+double studentT975(int df) {
+    const double z = 1.959964;
+    double z3 = z * z * z, z5 = z3 * z * z;
+    double n = df;
+    return z + (z3 + z) / (4 * n) + (5 * z5 + 16 * z3 + 3 * z) / (96 * n * n);
+}
+
+// Non-overlapping batch means of one observation sequence in constant memory:
+// at most max_batches batch means are kept, and when they are all filled
+// adjacent pairs merge and the batch size doubles. At report time batches keep
+// merging while their lag-1 autocorrelation is above the threshold
+class BatchMeans {
+public:
+    static const int MAX_BATCHES = 64;
+    static const int MIN_BATCHES = 10;
+
+    struct Interval {
+        double mean;
+        double half_width; // -1 - batches still correlated at MIN_BATCHES
+        int batches;
+        long long batch_size;
+        double lag1;
+    };
+
+private:
+    long long observations;
+    double total;
+    long long batch_size;
+    long long batch_count; // observations in the open batch
+    double batch_sum;
+    vector<double> batch_means;
+
+    static void mergePairs(vector<double>& means) {
+        for (size_t i = 0; i + 1 < means.size(); i += 2) means[i / 2] = (means[i] + means[i + 1]) / 2;
+        means.resize(means.size() / 2);
+    }
+
+    static double lag1Correlation(const vector<double>& means) {
+        double mean = 0;
+        for (double m : means) mean += m;
+        mean /= means.size();
+        double covariance = 0, variance = 0;
+        for (size_t i = 0; i < means.size(); i++) {
+            variance += (means[i] - mean) * (means[i] - mean);
+            if (i + 1 < means.size()) covariance += (means[i] - mean) * (means[i + 1] - mean);
+        }
+        return variance > 0 ? covariance / variance : 0;
+    }
+
+public:
+    BatchMeans() : observations(0), total(0), batch_size(1), batch_count(0), batch_sum(0) {
+        batch_means.reserve(MAX_BATCHES);
+    }
+
+    void reset() {
+        observations = 0;
+        total = 0;
+        batch_size = 1;
+        batch_count = 0;
+        batch_sum = 0;
+        batch_means.clear();
+    }
+
+    void add(double x) {
+        observations++;
+        total += x;
+        batch_sum += x;
+        if (++batch_count < batch_size) return;
+
+        batch_means.push_back(batch_sum / batch_size);
+        batch_sum = 0;
+        batch_count = 0;
+        if ((int)batch_means.size() == MAX_BATCHES) {
+            mergePairs(batch_means);
+            batch_size *= 2;
+        }
+    }
+
+    long long getObservations() const { return observations; }
+
+    Interval getInterval(double max_lag1 = 0.1) const {
+        Interval interval = { observations > 0 ? total / observations : 0, -1,
+            (int)batch_means.size(), batch_size, 0 };
+        vector<double> means = batch_means;
+        while ((int)means.size() >= MIN_BATCHES) {
+            interval.batches = (int)means.size();
+            interval.lag1 = lag1Correlation(means);
+            if (interval.lag1 <= max_lag1) {
+                double mean = 0, sq_sum = 0;
+                for (double m : means) mean += m;
+                mean /= means.size();
+                for (double m : means) sq_sum += (m - mean) * (m - mean);
+                double k = (double)means.size();
+                interval.half_width = studentT975((int)k - 1) * sqrt(sq_sum / (k - 1) / k);
+                break;
             }
+            mergePairs(means);
+            interval.batch_size *= 2;
         }
+        return interval;
+    }
 
-        printResults();
+    bool operator==(const BatchMeans& other) const {
+        return observations == other.observations && total == other.total &&
+            batch_size == other.batch_size && batch_count == other.batch_count &&
+            batch_sum == other.batch_sum && batch_means == other.batch_means;
     }
+};
 
-    void printResults() {
+// Statistics printed by printResults (constant memory, independent of run length).
+// Requests that arrived before start_time (warm-up, preloaded state) are not counted
+class SimulationStatistics {
+public:
+    double start_time;
+    int requests_generated;
+    int requests_served;
+    int requests_rejected;
+
+    vector<int> source_requests;
+    vector<int> source_rejections;
+    vector<double> source_total_time;
+    vector<double> source_waiting_time;
+    vector<double> device_busy_time;
+
+    TimeWeightedHistogram system_occupancy;         // requests in system (devices + buffer)
+    vector<TimeWeightedHistogram> buffer_occupancy; // requests in the buffer, by source
+    WindowCounters windows;
+
+    // Per-request observation sequences for confidence intervals of a single run.
+    // Rejection indicators (1 - rejected, 0 - served) follow the order requests leave
+    vector<BatchMeans> reject_batches;
+    vector<BatchMeans> total_time_batches;
+    vector<BatchMeans> waiting_time_batches;
+
+    PacketStatistics packets;
+
+    SimulationStatistics(int num_sources = 0, int num_devices = 0, double start = 0,
+        double window_length = 100.0, int window_buckets = 10)
+        : start_time(start), requests_generated(0), requests_served(0), requests_rejected(0),
+        source_requests(num_sources, 0), source_rejections(num_sources, 0),
+        source_total_time(num_sources, 0), source_waiting_time(num_sources, 0),
+        device_busy_time(num_devices, 0),
+        system_occupancy(start), buffer_occupancy(num_sources, TimeWeightedHistogram(start)),
+        windows(num_sources, start, window_length, window_buckets),
+        reject_batches(num_sources), total_time_batches(num_sources), waiting_time_batches(num_sources),
+        packets(num_sources, start) {
+    }
+
+    // Zero everything counted so far; occupancies continue from their current values
+    void restart(double start) {
+        SimulationStatistics fresh((int)source_requests.size(), (int)device_busy_time.size(), start,
+            windows.getWindowLength(), windows.getBuckets());
+        fresh.system_occupancy = system_occupancy;
+        fresh.system_occupancy.restart(start);
+        fresh.buffer_occupancy = buffer_occupancy;
+        for (auto& histogram : fresh.buffer_occupancy) histogram.restart(start);
+        fresh.packets = packets;
+        fresh.packets.restart((int)source_requests.size(), start);
+        *this = fresh;
+    }
+
+    // Statistics of an empty system at time start, without reallocating (model reset)
+    void reset(double start) {
+        start_time = start;
+        requests_generated = requests_served = requests_rejected = 0;
+        fill(source_requests.begin(), source_requests.end(), 0);
+        fill(source_rejections.begin(), source_rejections.end(), 0);
+        fill(source_total_time.begin(), source_total_time.end(), 0);
+        fill(source_waiting_time.begin(), source_waiting_time.end(), 0);
+        fill(device_busy_time.begin(), device_busy_time.end(), 0);
+        system_occupancy.reset(start);
+        for (auto& histogram : buffer_occupancy) histogram.reset(start);
+        windows.reset(start);
+        for (auto& batches : reject_batches) batches.reset();
+        for (auto& batches : total_time_batches) batches.reset();
+        for (auto& batches : waiting_time_batches) batches.reset();
+        packets.reset(start);
+    }
+
+    // State changes: a request entered (+1) or left (-1) the system / the buffer
+    void recordSystemChange(double time, int delta) {
+        system_occupancy.add(time, delta);
+    }
+
+    void recordBufferChange(int source_id, double time, int delta) {
+        buffer_occupancy[source_id].add(time, delta);
+    }
+
+    // Histogram range for the largest possible occupancies (no growth later)
+    void reserveOccupancy(int max_in_system, int max_in_buffer) {
+        system_occupancy.reserve(max_in_system);
+        for (auto& histogram : buffer_occupancy) histogram.reserve(max_in_buffer);
+    }
+
+    // A request was taken from the buffer for the packet of serving_source
+    void recordPacketDispatch(int serving_source, double time) {
+        packets.recordDispatch(serving_source, time);
+    }
+
+    // Pool the occupancy distributions of another replication observed up to other_time
+    void mergeOccupancy(const SimulationStatistics& other, double other_time) {
+        system_occupancy.merge(other.system_occupancy, other_time);
+        for (size_t i = 0; i < buffer_occupancy.size(); i++) {
+            buffer_occupancy[i].merge(other.buffer_occupancy[i], other_time);
+        }
+    }
+
+    void recordArrival(int source_id, double time) {
+        requests_generated++;
+        source_requests[source_id]++;
+        windows.record(source_id, WindowCounters::ARRIVED, time);
+    }
+
+    void recordRejection(int source_id, double arrival_time, double time) {
+        if (arrival_time < start_time) return;
+        source_rejections[source_id]++;
+        requests_rejected++;
+        windows.record(source_id, WindowCounters::REJECTED, time);
+        reject_batches[source_id].add(1);
+    }
+
+    void recordDeparture(int source_id, int device_id, double arrival_time,
+        double start_service_time, double finish_service_time) {
+        if (arrival_time < start_time) return;
+        requests_served++;
+        source_total_time[source_id] += finish_service_time - arrival_time;
+        source_waiting_time[source_id] += start_service_time - arrival_time;
+        device_busy_time[device_id] += finish_service_time - start_service_time;
+        windows.record(source_id, WindowCounters::SERVED, finish_service_time);
+        reject_batches[source_id].add(0);
+        total_time_batches[source_id].add(finish_service_time - arrival_time);
+        waiting_time_batches[source_id].add(start_service_time - arrival_time);
+    }
+
+    int getServedRequests(int source_id) const {
+        return source_requests[source_id] - source_rejections[source_id];
+    }
+
+    double getRejectProbability(int source_id) const {
+        return source_requests[source_id] > 0 ?
+            (double)source_rejections[source_id] / source_requests[source_id] : 0;
+    }
+
+    double getAverageTotalTime(int source_id) const {
+        int served_requests = getServedRequests(source_id);
+        return served_requests > 0 ? source_total_time[source_id] / served_requests : 0;
+    }
+
+    double getAverageWaitingTime(int source_id) const {
+        int served_requests = getServedRequests(source_id);
+        return served_requests > 0 ? source_waiting_time[source_id] / served_requests : 0;
+    }
+
+    double getUtilization(int device_id, double current_time) const {
+        double elapsed = current_time - start_time;
+        return elapsed > 0 ? device_busy_time[device_id] / elapsed : 0;
+    }
+
+    bool operator==(const SimulationStatistics& other) const {
+        return start_time == other.start_time && requests_generated == other.requests_generated &&
+            requests_served == other.requests_served && requests_rejected == other.requests_rejected &&
+            source_requests == other.source_requests && source_rejections == other.source_rejections &&
+            source_total_time == other.source_total_time &&
+            source_waiting_time == other.source_waiting_time && device_busy_time == other.device_busy_time &&
+            system_occupancy == other.system_occupancy && buffer_occupancy == other.buffer_occupancy &&
+            windows == other.windows && reject_batches == other.reject_batches &&
+            total_time_batches == other.total_time_batches &&
+            waiting_time_batches == other.waiting_time_batches && packets == other.packets;
+    }
+
+    void print(double current_time, int current_serving_source,
+        int buffer_max_size, int buffer_size) const {
         cout << "\n=== SIMULATION RESULTS ===" << endl;
         cout << "Total simulation time: " << current_time << " units" << endl;
         cout << "Requests generated: " << requests_generated << endl;
@@ -437,14 +1709,10 @@ public:
             << setw(12) << "Rejected" << setw(12) << "P_reject"
             << setw(12) << "T_total" << setw(12) << "T_wait" << endl;
 
-        for (size_t i = 0; i < sources.size(); i++) {
-            int served_requests = source_requests[i] - source_rejections[i];
-            double reject_prob = source_requests[i] > 0 ?
-                (double)source_rejections[i] / source_requests[i] : 0;
-            double avg_total_time = served_requests > 0 ?
-                source_total_time[i] / served_requests : 0;
-            double avg_waiting_time = served_requests > 0 ?
-                source_waiting_time[i] / served_requests : 0;
+        for (int i = 0; i < (int)source_requests.size(); i++) {
+            double reject_prob = getRejectProbability(i);
+            double avg_total_time = getAverageTotalTime(i);
+            double avg_waiting_time = getAverageWaitingTime(i);
 
             string source_name = "S" + to_string(i + 1);
             cout << setw(10) << source_name
@@ -459,8 +1727,8 @@ public:
         cout << "\n--- DEVICE CHARACTERISTICS ---" << endl;
         cout << setw(10) << "Device" << setw(15) << "Utilization" << endl;
 
-        for (size_t i = 0; i < devices.size(); i++) {
-            double utilization = current_time > 0 ? device_busy_time[i] / current_time : 0;
+        for (int i = 0; i < (int)device_busy_time.size(); i++) {
+            double utilization = getUtilization(i, current_time);
             string device_name = "D" + to_string(i + 1);
             cout << setw(10) << device_name
                 << setw(15) << fixed << setprecision(3) << utilization
@@ -471,17 +1739,5827 @@ public:
         string current_packet = (current_serving_source == -1) ? "none" : "S" + to_string(current_serving_source + 1);
         cout << "Packet service: Current packet = " << current_packet << endl;
         cout << "Rejections: Total rejected = " << requests_rejected << endl;
-        cout << "Buffer: Max size = " << buffer->getMaxSize()
-            << ", Current size = " << buffer->getSize() << endl;
+        cout << "Buffer: Max size = " << buffer_max_size
+            << ", Current size = " << buffer_size << endl;
+
+        printOccupancy(current_time);
+        printWindows();
+        printBatchMeans();
+        printPackets(current_serving_source);
+    }
+
+    // Closed packets only; the packet still in service is left out
+    void printPackets(int current_serving_source) const {
+        cout << "\n--- PACKET SERVICE ---" << endl;
+        cout << setw(10) << "Source" << setw(10) << "Packets" << setw(12) << "Avg length"
+            << setw(12) << "Max length" << setw(14) << "Avg duration" << setw(14) << "Max duration"
+            << setw(16) << "Dispatch share" << endl;
+        for (int i = 0; i < (int)source_requests.size(); i++) {
+            cout << setw(10) << "S" + to_string(i + 1)
+                << setw(10) << packets.getPackets(i)
+                << setw(12) << fixed << setprecision(2) << packets.getAverageLength(i)
+                << setw(12) << packets.getMaxLength(i)
+                << setw(14) << fixed << setprecision(2) << packets.getAverageDuration(i)
+                << setw(14) << fixed << setprecision(2) << packets.getMaxDuration(i)
+                << setw(16) << fixed << setprecision(3) << packets.getDispatchShare(i) << endl;
+        }
+
+        // Jain's index of the served fractions: 1 - every source equally served
+        double sum = 0, sq_sum = 0;
+        int num_sources = (int)source_requests.size();
+        for (int i = 0; i < num_sources; i++) {
+            double served_fraction = 1 - getRejectProbability(i);
+            sum += served_fraction;
+            sq_sum += served_fraction * served_fraction;
+        }
+        double jain = sq_sum > 0 ? sum * sum / (num_sources * sq_sum) : 1;
+        string current_packet = (current_serving_source == -1) ? "none" : "S" + to_string(current_serving_source + 1);
+        cout << "Packet switches: " << packets.getSwitches() << ", packet in service: " << current_packet
+            << ", fairness (Jain, served fraction): " << fixed << setprecision(3) << jain << endl;
+    }
+
+    void printBatchMeans() const {
+        cout << "\n--- BATCH MEANS (95% confidence) ---" << endl;
+        cout << setw(10) << "Source" << setw(12) << "Statistic" << setw(12) << "Mean"
+            << setw(12) << "Half-width" << setw(10) << "Batches" << setw(12) << "Batch size"
+            << setw(10) << "Lag-1" << endl;
+        for (int i = 0; i < (int)source_requests.size(); i++) {
+            const BatchMeans* estimators[] = { &reject_batches[i], &total_time_batches[i], &waiting_time_batches[i] };
+            const char* names[] = { "P_reject", "T_total", "T_wait" };
+            for (int k = 0; k < 3; k++) {
+                BatchMeans::Interval interval = estimators[k]->getInterval();
+                cout << setw(10) << "S" + to_string(i + 1) << setw(12) << names[k]
+                    << setw(12) << fixed << setprecision(4) << interval.mean;
+                if (interval.half_width < 0) {
+                    cout << setw(12) << "n/a";
+                }
+                else {
+                    cout << setw(12) << fixed << setprecision(4) << interval.half_width;
+                }
+                cout << setw(10) << interval.batches << setw(12) << interval.batch_size
+                    << setw(10) << fixed << setprecision(3) << interval.lag1 << endl;
+            }
+        }
+    }
+
+    void printWindows() const {
+        double length = windows.getWindowLength();
+        cout << "\n--- RATE WINDOWS (tumbling " << fixed << setprecision(2) << length
+            << ", sliding " << length * windows.getBuckets() << " units, "
+            << windows.getClosedWindows() << " complete windows) ---" << endl;
+        if (windows.getClosedWindows() == 0) {
+            cout << "No complete window" << endl;
+            return;
+        }
+        cout << setw(10) << "Source" << setw(12) << "Rej/window" << setw(12) << "at"
+            << setw(12) << "P_reject" << setw(12) << "Min served"
+            << setw(14) << "Sliding rej" << setw(12) << "until" << setw(12) << "P_reject" << endl;
+        for (int i = 0; i < (int)source_requests.size(); i++) {
+            const WindowCounters::Peaks& p = windows.getPeaks(i);
+            cout << setw(10) << "S" + to_string(i + 1)
+                << setw(12) << p.max_rejections
+                << setw(12) << fixed << setprecision(2) << p.max_rejections_start
+                << setw(12) << fixed << setprecision(3) << p.max_reject_prob
+                << setw(12) << p.min_served
+                << setw(14) << p.max_sliding_rejections;
+            if (windows.getClosedWindows() >= windows.getBuckets()) {
+                cout << setw(12) << fixed << setprecision(2) << p.max_sliding_end
+                    << setw(12) << fixed << setprecision(3) << p.max_sliding_reject_prob;
+            }
+            else {
+                cout << setw(12) << "-" << setw(12) << "-";
+            }
+            cout << endl;
+        }
+    }
+
+    void printOccupancy(double current_time) const {
+        const int max_table_rows = 16;
+        cout << "\n--- OCCUPANCY DISTRIBUTION (time-weighted) ---" << endl;
+        cout << "Requests in system: mean = " << fixed << setprecision(3)
+            << system_occupancy.getMean(current_time)
+            << ", p95 = " << system_occupancy.getQuantile(0.95, current_time)
+            << ", p99 = " << system_occupancy.getQuantile(0.99, current_time)
+            << ", max = " << system_occupancy.getMaxValue() << endl;
+        if (system_occupancy.getMaxValue() < max_table_rows) {
+            vector<double> probabilities = system_occupancy.getProbabilities(current_time);
+            cout << setw(10) << "N" << setw(12) << "P(N)" << endl;
+            for (int k = 0; k <= system_occupancy.getMaxValue(); k++) {
+                cout << setw(10) << k << setw(12) << fixed << setprecision(4) << probabilities[k] << endl;
+            }
+        }
+
+        cout << setw(10) << "Source" << setw(12) << "Buf mean" << setw(12) << "P(empty)"
+            << setw(8) << "p95" << setw(8) << "p99" << setw(8) << "Max" << endl;
+        for (size_t i = 0; i < buffer_occupancy.size(); i++) {
+            const TimeWeightedHistogram& histogram = buffer_occupancy[i];
+            cout << setw(10) << "S" + to_string(i + 1)
+                << setw(12) << fixed << setprecision(3) << histogram.getMean(current_time)
+                << setw(12) << fixed << setprecision(4) << histogram.getProbabilities(current_time)[0]
+                << setw(8) << histogram.getQuantile(0.95, current_time)
+                << setw(8) << histogram.getQuantile(0.99, current_time)
+                << setw(8) << histogram.getMaxValue() << endl;
+        }
+    }
+};
+
+// Full state of a SimulationModel between two events (parameters excluded)
+template <typename Engine>
+struct ModelSnapshot {
+    long long event_count;
+    double current_time;
+    int current_serving_source;
+    int last_used_device;
+    priority_queue<Event, vector<Event>, greater<Event>> calendar;
+    RequestTable requests;
+    RingQueue<RequestHandle> buffer_contents;
+    vector<RequestHandle> device_requests;
+    vector<Engine> streams;
+    SimulationStatistics stats;
+};
+
+// Compact trajectory log of one run: only the parameter-sensitive decisions,
+// kept as first occurrences, plus periodic checkpoints of the model state
+template <typename Engine>
+struct Trajectory {
+    long long checkpoint_interval;
+    vector<long long> first_busy_arrival;  // [occupancy] -> first event where an arrival found
+                                           // all devices busy and this many requests buffered
+    vector<long long> first_service_start; // [device] -> first event starting a service there
+    vector<ModelSnapshot<Engine>> checkpoints;
+
+    Trajectory(int buffer_size, int num_devices, long long interval)
+        : checkpoint_interval(interval), first_busy_arrival(buffer_size + 1, -1),
+        first_service_start(num_devices, -1) {
+    }
+
+    void recordBusyArrival(long long event, int occupancy) {
+        if (occupancy < (int)first_busy_arrival.size() && first_busy_arrival[occupancy] == -1) {
+            first_busy_arrival[occupancy] = event;
+        }
+    }
+
+    void recordServiceStart(long long event, int device_id) {
+        if (first_service_start[device_id] == -1) first_service_start[device_id] = event;
     }
 };
 
-int main() {
-    SimulationModel model;
-    model.run(1000.0, 1000);
+// Wall-clock phase trace in Chrome trace-event format (chrome://tracing,
+// ui.perfetto.dev). Each thread appends complete events to its own buffer,
+// owned by the recorder so it outlives worker threads; write() merges them
+class TraceRecorder {
+public:
+    struct TraceEvent {
+        const char* name;
+        double start_us;
+        double duration_us;
+        int arg; // replication or sweep point, -1 - none
+    };
+
+private:
+    struct ThreadBuffer {
+        int thread_id;
+        bool is_main;
+        vector<TraceEvent> events;
+    };
+
+    atomic<bool> enabled;
+    chrono::steady_clock::time_point epoch;
+    thread::id main_thread; // the recorder is a global, built on the main thread
+    mutex buffers_mutex;
+    vector<unique_ptr<ThreadBuffer>> buffers;
+
+    ThreadBuffer* threadBuffer() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        thread_local TraceRecorder* owner = nullptr;
+        if (owner != this) {
+            lock_guard<mutex> lock(buffers_mutex);
+            buffers.push_back(unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+            buffer = buffers.back().get();
+            buffer->thread_id = (int)buffers.size();
+            buffer->is_main = this_thread::get_id() == main_thread;
+            buffer->events.reserve(1024);
+            owner = this;
+        }
+        return buffer;
+    }
+
+public:
+    TraceRecorder() : enabled(false), epoch(chrono::steady_clock::now()), main_thread(this_thread::get_id()) {}
+
+    void enable() { enabled = true; }
+    bool isEnabled() const { return enabled; }
+
+    double nowUs() const {
+        return chrono::duration<double, micro>(chrono::steady_clock::now() - epoch).count();
+    }
+
+    void record(const char* name, double start_us, double end_us, int arg) {
+        TraceEvent event = { name, start_us, end_us - start_us, arg };
+        threadBuffer()->events.push_back(event);
+    }
+
+    // Call once the worker threads have finished
+    bool write(const string& path) {
+        ofstream out(path);
+        if (!out) return false;
+        lock_guard<mutex> lock(buffers_mutex);
+        out << "{\"traceEvents\":[" << endl;
+        out << fixed << setprecision(3);
+        bool first = true;
+        for (const auto& buffer : buffers) {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+                << buffer->thread_id << ",\"args\":{\"name\":\""
+                << (buffer->is_main ? "main" : "worker " + to_string(buffer->thread_id)) << "\"}}";
+            first = false;
+            for (const auto& event : buffer->events) {
+                out << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"sim\",\"ph\":\"X\",\"ts\":"
+                    << event.start_us << ",\"dur\":" << event.duration_us
+                    << ",\"pid\":1,\"tid\":" << buffer->thread_id;
+                if (event.arg >= 0) out << ",\"args\":{\"index\":" << event.arg << "}";
+                out << "}";
+            }
+        }
+        out << "\n]}" << endl;
+        return (bool)out;
+    }
+};
+
+TraceRecorder trace_recorder;
+
+// Flush of --trace at the end of a mode (no-op without the option)
+void writeTrace(const string& path) {
+    if (path.empty()) return;
+    if (trace_recorder.write(path)) {
+        cout << "Trace written to " << path << endl;
+    }
+    else {
+        cout << "Cannot write trace to " << path << endl;
+    }
+}
+
+// Records the enclosing scope (or up to finish()) as one trace event; a
+// single flag test when tracing is off. name must be a string literal
+class ScopedTrace {
+private:
+    const char* name;
+    int arg;
+    double start_us; // < 0 - not recording
+
+public:
+    ScopedTrace(const char* event_name, int event_arg = -1)
+        : name(event_name), arg(event_arg),
+        start_us(trace_recorder.isEnabled() ? trace_recorder.nowUs() : -1) {
+    }
+
+    ~ScopedTrace() { finish(); }
+
+    void finish() {
+        if (start_us < 0) return;
+        trace_recorder.record(name, start_us, trace_recorder.nowUs(), arg);
+        start_us = -1;
+    }
+};
+
+// Hardware counter totals of one measured section
+struct CounterValues {
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t branch_misses;
+    uint64_t cache_misses;
+};
+
+// Hardware counters of the calling thread (Linux perf_event_open, user space
+// only). Elsewhere, or when the kernel refuses, isAvailable() is false
+class HardwareCounters {
+private:
+    static const int NUM_COUNTERS = 4;
+    int fds[NUM_COUNTERS]; // fds[0] - group leader
+
+public:
+    HardwareCounters() {
+        for (int i = 0; i < NUM_COUNTERS; i++) fds[i] = -1;
+#ifdef __linux__
+        const uint64_t configs[NUM_COUNTERS] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES };
+        for (int i = 0; i < NUM_COUNTERS; i++) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.disabled = i == 0 ? 1 : 0; // the group starts with its leader
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds[0], 0);
+            if (fds[i] < 0) {
+                close();
+                return;
+            }
+        }
+#endif
+    }
+
+    ~HardwareCounters() { close(); }
+
+    HardwareCounters(const HardwareCounters&) = delete;
+    HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+    bool isAvailable() const { return fds[0] >= 0; }
+
+    void start() {
+#ifdef __linux__
+        if (!isAvailable()) return;
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    CounterValues stop() {
+        CounterValues values = { 0, 0, 0, 0 };
+#ifdef __linux__
+        if (!isAvailable()) return values;
+        ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        uint64_t data[1 + NUM_COUNTERS] = { 0 }; // number of counters, then the values
+        if (read(fds[0], data, sizeof(data)) == (ssize_t)sizeof(data)) {
+            values.cycles = data[1];
+            values.instructions = data[2];
+            values.branch_misses = data[3];
+            values.cache_misses = data[4];
+        }
+#endif
+        return values;
+    }
+
+private:
+    void close() {
+#ifdef __linux__
+        for (int i = NUM_COUNTERS - 1; i >= 0; i--) {
+            if (fds[i] >= 0) ::close(fds[i]);
+            fds[i] = -1;
+        }
+#endif
+    }
+};
+
+// Per-operation ratios of a measured section (an operation: event, call, ...)
+void printCounterRatios(const CounterValues& values, long long operations) {
+    double n = operations > 0 ? (double)operations : 1;
+    cout << setw(10) << fixed << setprecision(1) << values.cycles / n
+        << setw(10) << fixed << setprecision(1) << values.instructions / n
+        << setw(8) << fixed << setprecision(2)
+        << (values.cycles > 0 ? (double)values.instructions / values.cycles : 0)
+        << setw(12) << fixed << setprecision(4) << values.branch_misses / n
+        << setw(12) << fixed << setprecision(4) << values.cache_misses / n;
+}
+
+void printCounterHeader() {
+    cout << setw(10) << "Cycles" << setw(10) << "Instr" << setw(8) << "IPC"
+        << setw(12) << "Br-miss" << setw(12) << "Cache-miss";
+}
+
+// Counter section printed after the results of run()
+void printRunCounters(const HardwareCounters& counters, const CounterValues& values, long long events) {
+    cout << "\n--- HARDWARE COUNTERS (per event, " << events << " events) ---" << endl;
+    if (!counters.isAvailable()) {
+        cout << "Hardware counters unavailable (perf_event_open refused, or not Linux)" << endl;
+        return;
+    }
+    printCounterHeader();
+    cout << endl;
+    printCounterRatios(values, events);
+    cout << endl;
+}
+
+void printModelHeader(const string& title, const ModelConfig& config,
+    double max_time, int max_requests) {
+    cout << "=== " << title << " ===" << endl;
+    cout << "DISCIPLINES:" << endl;
+    cout << "- Infinite sources" << endl;
+    cout << (config.arrivals == ARRIVALS_EXPONENTIAL ? "- Poisson request flow (exponential variant)" :
+        "- Uniform request distribution") << endl;
+    cout << "- Exponential service time" << endl;
+    cout << "- FIFO buffering" << endl;
+    cout << "- Rejection by source priority" << endl;
+    cout << "- Packet service" << endl;
+    cout << "- Round-robin device selection" << endl;
+    cout << "Parameters: " << config.getNumSources() << " sources, "
+        << config.getNumDevices() << " devices, buffer: " << config.buffer_size << endl;
+    if (config.engine == ENGINE_XOSHIRO) {
+        cout << "Random engine: xoshiro256++, replication " << config.replication << endl;
+    }
+    else if (config.engine == ENGINE_PCG) {
+        cout << "Random engine: PCG64, replication " << config.replication << endl;
+    }
+    if (config.sampler == SAMPLER_ZIGGURAT) {
+        cout << "Sampler: ziggurat exponential, single-multiply uniform" << endl;
+    }
+    if (config.prefetch) {
+        cout << "Variates: " << (config.engine == ENGINE_DEFAULT ?
+            "generated inline (prefetch needs --engine xoshiro|pcg)" :
+            "prefetched by a producer thread") << endl;
+    }
+    cout << "Max time: " << max_time << " units" << endl;
+    cout << "Max requests: " << max_requests << endl;
+    cout << "----------------------------------------" << endl;
+}
+
+// Main simulation model
+template <typename Engine>
+class BasicSimulationModel {
+private:
+    typedef BasicSource<Engine> Source;
+    typedef BasicDevice<Engine> Device;
+
+    MonotonicArena arena; // sources, devices, buffer and selector (destroyed last)
+    priority_queue<Event, vector<Event>, greater<Event>> calendar;
+    vector<Source*> sources;
+    vector<Device*> devices;
+    RequestTable requests;
+    Buffer* buffer;
+    DeviceSelector* device_selector;
+    VariatePrefetcher* prefetcher; // nullptr - variates generated inline
+    vector<Engine> streams; // see makeModelStreams
+    vector<Engine> initial_streams; // start states of streams, for reset()
+    ModelConfig config;
+
+    double current_time;
+    int current_serving_source;
+    SimulationStatistics stats;
+    long long event_count;
+    Trajectory<Engine>* trajectory; // nullptr - not recorded
+
+    Engine& streamOf(int entity) {
+        return streams[StreamFactory<Engine>::independent_streams ? entity : 0];
+    }
+
+    void startService(Device* device, RequestHandle request) {
+        double service_time = device->getServiceTime();
+        device->startService(request, current_time);
+        calendar.push(Event(current_time + service_time, Event::DEPARTURE,
+            device->getId(), request));
+        if (trajectory) trajectory->recordServiceStart(event_count, device->getId());
+    }
+
+public:
+    BasicSimulationModel(const ModelConfig& model_config = ModelConfig())
+        : prefetcher(nullptr), streams(makeModelStreams<Engine>(model_config)), initial_streams(streams),
+        config(model_config),
+        current_time(0), current_serving_source(-1),
+        stats(model_config.getNumSources(), model_config.getNumDevices(), 0,
+            model_config.window_length, model_config.window_buckets),
+        event_count(0), trajectory(nullptr) {
+
+        // Create sources
+        int num_sources = config.getNumSources();
+        for (int i = 0; i < num_sources; i++) {
+            sources.push_back(arena.create<Source>(i, config.source_min_intervals[i],
+                config.source_max_intervals[i], streamOf(i), config.sampler, config.arrivals));
+        }
+
+        // Create devices
+        int num_devices = config.getNumDevices();
+        for (int i = 0; i < num_devices; i++) {
+            devices.push_back(arena.create<Device>(i, config.device_mean_times[i],
+                streamOf(num_sources + i), requests,
+                config.sampler));
+        }
+
+        buffer = arena.create<Buffer>(config.buffer_size, RequestSourceOf(requests));
+        device_selector = arena.create<DeviceSelector>(num_devices);
+
+        // Sized for the largest population, so the event loop never allocates:
+        // one pending event per source and device, at most every device busy plus
+        // a full buffer plus the arrival being placed
+        vector<Event> calendar_storage;
+        calendar_storage.reserve(num_sources + num_devices);
+        calendar = priority_queue<Event, vector<Event>, greater<Event>>(greater<Event>(),
+            move(calendar_storage));
+        requests.reserve(num_devices + config.buffer_size + 1);
+        stats.reserveOccupancy(num_devices + config.buffer_size, config.buffer_size);
+
+        if (config.prefetch && StreamFactory<Engine>::independent_streams) {
+            prefetcher = startPrefetcher(sources, devices);
+        }
+
+        for (int i = 0; i < num_sources; i++) {
+            double first_time = sources[i]->getNextInterval();
+            calendar.push(Event(first_time, Event::ARRIVAL, i));
+        }
+    }
+
+    ~BasicSimulationModel() {
+        delete prefetcher; // stops the producer before the entities go away
+    }
+
+    // Start a new replication in place: same structure and parameters, streams
+    // re-seeded, empty system at time 0. Reuses every container and entity, so
+    // it does not allocate (except for restarting the prefetcher, seeding
+    // default_random_engine with a seed_seq or caching the replication starts
+    // of a new xoshiro seed)
+    void reset(unsigned seed, int replication) {
+        delete prefetcher;
+        prefetcher = nullptr;
+
+        // A later replication of the same seed only jumps the start states ahead
+        if (seed != 0 && seed == config.seed && replication >= config.replication) {
+            for (size_t i = 0; i < initial_streams.size(); i++) {
+                if (replication > config.replication) {
+                    StreamFactory<Engine>::skipReplications(initial_streams[i], seed,
+                        config.replication, replication, (int)i);
+                }
+            }
+            config.replication = replication;
+        }
+        else {
+            config.seed = seed;
+            config.replication = replication;
+            reseedModelStreams(initial_streams, config);
+        }
+        for (size_t i = 0; i < streams.size(); i++) streams[i] = initial_streams[i];
+
+        while (!calendar.empty()) calendar.pop();
+        requests.clear();
+        buffer->clear();
+        for (auto source : sources) source->reset();
+        for (auto device : devices) device->reset();
+        device_selector->setLastUsed(-1);
+        current_time = 0;
+        current_serving_source = -1;
+        stats.reset(0);
+        event_count = 0;
+        trajectory = nullptr;
+
+        if (config.prefetch && StreamFactory<Engine>::independent_streams) {
+            prefetcher = startPrefetcher(sources, devices);
+        }
+        for (auto source : sources) {
+            calendar.push(Event(source->getNextInterval(), Event::ARRIVAL, source->getId()));
+        }
+    }
+
+    void processArrival(int source_id) {
+        stats.recordArrival(source_id, current_time);
+        RequestHandle request = requests.create(source_id,
+            stats.source_requests[source_id], current_time);
+
+        double next_time = current_time + sources[source_id]->getNextInterval();
+        calendar.push(Event(next_time, Event::ARRIVAL, source_id));
+
+        Device* free_device = device_selector->getFreeDevice(devices);
+        if (free_device) {
+            stats.recordSystemChange(current_time, +1);
+            startService(free_device, request);
+        }
+        else {
+            if (trajectory) trajectory->recordBusyArrival(event_count, buffer->getSize());
+            if (!buffer->isFull()) {
+                buffer->addRequest(request);
+            }
+            else {
+                RequestHandle rejected_request;
+                if (buffer->findRequestToReject(rejected_request)) {
+                    int rejected_source = requests.getSourceId(rejected_request);
+                    stats.recordRejection(rejected_source, requests.getArrivalTime(rejected_request),
+                        current_time);
+                    stats.recordBufferChange(rejected_source, current_time, -1);
+                    stats.recordSystemChange(current_time, -1);
+                    buffer->removeRequest(rejected_request);
+                    requests.release(rejected_request);
+                }
+                buffer->addRequest(request);
+            }
+            stats.recordBufferChange(source_id, current_time, +1);
+            stats.recordSystemChange(current_time, +1);
+        }
+    }
+
+    void processDeparture(int device_id, RequestHandle event_request) {
+        Device* device = devices[device_id];
+        RequestHandle finished_request = device->finishService();
+        // The departure event must refer to the request the device is serving
+        assert(finished_request == event_request && requests.isValid(finished_request));
+        (void)event_request;
+
+        if (finished_request != INVALID_REQUEST) {
+            stats.recordDeparture(requests.getSourceId(finished_request), device_id,
+                requests.getArrivalTime(finished_request),
+                requests.getStartServiceTime(finished_request), current_time);
+            stats.recordSystemChange(current_time, -1);
+            requests.release(finished_request);
+        }
+
+        if (!buffer->isEmpty()) {
+            RequestHandle next_request;
+            if (buffer->getNextRequest(current_serving_source, next_request)) {
+                buffer->removeRequest(next_request);
+                stats.recordPacketDispatch(current_serving_source, current_time);
+                stats.recordBufferChange(requests.getSourceId(next_request), current_time, -1);
+
+                Device* free_device = device_selector->getFreeDevice(devices);
+                if (free_device) {
+                    startService(free_device, next_request);
+                }
+            }
+        }
+    }
+
+    // Event loop without any output; returns the number of processed events.
+    // At most max_events are processed, so a caller can advance the model in
+    // slices (it is finished once a slice comes back short)
+    long long simulate(double max_time, int max_requests, long long max_events = LLONG_MAX) {
+        long long events = 0;
+        while (events < max_events && !calendar.empty() && current_time < max_time &&
+            stats.requests_served < max_requests) {
+            if (trajectory && event_count % trajectory->checkpoint_interval == 0) {
+                trajectory->checkpoints.push_back(saveSnapshot());
+            }
+
+            Event event = calendar.top();
+            calendar.pop();
+            current_time = event.time;
+
+            if (event.getType() == Event::ARRIVAL) {
+                processArrival(event.entity_id);
+            }
+            else if (event.getType() == Event::DEPARTURE) {
+                processDeparture(event.entity_id, event.request);
+            }
+            events++;
+            event_count++;
+        }
+        return events;
+    }
+
+    // Touch the lines the next event will need first: the calendar top (with
+    // its children) and the buffer head
+    void prefetch() const {
+        if (!calendar.empty()) PREFETCH(&calendar.top());
+        PREFETCH(buffer->getHeadAddress());
+    }
+
+    // Record decisions and checkpoints of the following events into log
+    void recordTrajectory(Trajectory<Engine>* log) { trajectory = log; }
+
+    ModelSnapshot<Engine> saveSnapshot() const {
+        ModelSnapshot<Engine> snapshot;
+        snapshot.event_count = event_count;
+        snapshot.current_time = current_time;
+        snapshot.current_serving_source = current_serving_source;
+        snapshot.last_used_device = device_selector->getLastUsed();
+        snapshot.calendar = calendar;
+        snapshot.requests = requests;
+        snapshot.buffer_contents = buffer->getContents();
+        for (auto device : devices) snapshot.device_requests.push_back(device->getCurrentRequest());
+        snapshot.streams = streams;
+        snapshot.stats = stats;
+        return snapshot;
+    }
+
+    // Continue from a snapshot of a model with the same sources and devices
+    // (other parameters may differ). Streams are assigned in place, because
+    // sources and devices hold references to them
+    void restoreSnapshot(const ModelSnapshot<Engine>& snapshot) {
+        assert(snapshot.streams.size() == streams.size() && snapshot.device_requests.size() == devices.size());
+        event_count = snapshot.event_count;
+        current_time = snapshot.current_time;
+        current_serving_source = snapshot.current_serving_source;
+        device_selector->setLastUsed(snapshot.last_used_device);
+        calendar = snapshot.calendar;
+        requests = snapshot.requests;
+        buffer->setContents(snapshot.buffer_contents);
+        for (size_t i = 0; i < devices.size(); i++) devices[i]->setCurrentRequest(snapshot.device_requests[i]);
+        for (size_t i = 0; i < streams.size(); i++) streams[i] = snapshot.streams[i];
+        stats = snapshot.stats;
+    }
+
+    long long getEventCount() const { return event_count; }
+
+    // Start from a given state at time 0 instead of the empty system. The preloaded
+    // requests arrived "before" the run and are left out of the statistics; with
+    // exponential services the remaining service times are drawn afresh
+    void loadState(const SystemState& state) {
+        const double before_start = -numeric_limits<double>::infinity();
+        for (int i = 0; i < (int)devices.size(); i++) {
+            if (!state.device_busy[i]) continue;
+            RequestHandle request = requests.create(0, 0, before_start);
+            stats.recordSystemChange(current_time, +1);
+            devices[i]->startService(request, current_time);
+            calendar.push(Event(current_time + devices[i]->getServiceTime(), Event::DEPARTURE,
+                i, request));
+        }
+        for (int source_id = 0; source_id < (int)state.buffer_counts.size(); source_id++) {
+            for (int k = 0; k < state.buffer_counts[source_id]; k++) {
+                buffer->addRequest(requests.create(source_id, 0, before_start));
+                stats.recordSystemChange(current_time, +1);
+                stats.recordBufferChange(source_id, current_time, +1);
+            }
+        }
+        device_selector->setLastUsed(state.last_used_device);
+        current_serving_source = state.current_serving_source;
+    }
+
+    // Discard everything counted so far (end of a warm-up period)
+    void resetStatistics() {
+        stats.restart(current_time);
+    }
+
+    const SimulationStatistics& getStatistics() const { return stats; }
+    double getCurrentTime() const { return current_time; }
+
+    void run(double max_time = 1000.0, int max_requests = 1000) {
+        printModelHeader("SIMULATION MODEL VARIANT 6", config, max_time, max_requests);
+        // Counters (--perf) cover the main loop only, inside its trace scope
+        unique_ptr<HardwareCounters> counters(config.perf_counters ? new HardwareCounters() : nullptr);
+        CounterValues values = {};
+        long long events;
+        {
+            ScopedTrace trace("main loop");
+            if (counters) counters->start();
+            events = simulate(max_time, max_requests);
+            if (counters) values = counters->stop();
+        }
+        ScopedTrace trace("reporting");
+        printResults();
+        if (counters) printRunCounters(*counters, values, events);
+    }
+
+    void printResults() {
+        stats.print(current_time, current_serving_source,
+            buffer->getMaxSize(), buffer->getSize());
+    }
+};
+
+typedef BasicSimulationModel<default_random_engine> SimulationModel;
+
+// Buffer slot of the streaming mode: request fields carried inline
+struct BufferSlot {
+    int source_id;
+    double arrival_time;
+};
+
+struct BufferSlotSourceOf {
+    int operator()(const BufferSlot& slot) const { return slot.source_id; }
+};
+
+typedef BasicBuffer<BufferSlot, BufferSlotSourceOf> StreamBuffer;
+
+// Device of the streaming mode: keeps the served request in its departure slot
+template <typename Engine>
+class BasicStreamDevice {
+private:
+    exponential_distribution<double> dist; // Exponential distribution
+    Engine& generator;
+    int device_id;
+    SamplerType sampler;
+    SpscRing<double>* prefetch_ring; // nullptr - generate inline
+    bool busy;
+
+public:
+    // Departure slot
+    int source_id;
+    double arrival_time;
+    double start_service_time;
+
+    BasicStreamDevice(int id, double mean_time, Engine& gen,
+        SamplerType sampler_type = SAMPLER_STD)
+        : dist(1.0 / mean_time), generator(gen), device_id(id), sampler(sampler_type),
+        prefetch_ring(nullptr), busy(false), source_id(-1), arrival_time(0), start_service_time(0) {
+    }
+
+    double sampleServiceTime() {
+        if (sampler == SAMPLER_ZIGGURAT) {
+            return ZigguratExponential::sample(generator) / dist.lambda();
+        }
+        return dist(generator);
+    }
+
+    double getServiceTime() {
+        if (prefetch_ring) return VariatePrefetcher::take(prefetch_ring);
+        return sampleServiceTime();
+    }
+
+    void setPrefetchRing(SpscRing<double>* ring) { prefetch_ring = ring; }
+
+    bool isFree() const { return !busy; }
+
+    void startService(const BufferSlot& request, double current_time) {
+        busy = true;
+        source_id = request.source_id;
+        arrival_time = request.arrival_time;
+        start_service_time = current_time;
+    }
+
+    void finishService() { busy = false; }
+
+    int getId() const { return device_id; }
+};
+
+// Event of the streaming mode (no request attached)
+struct StreamEvent {
+    double time;
+    int entity_id;
+    Event::Type type;
+
+    StreamEvent(double t, Event::Type tp, int id) : time(t), entity_id(id), type(tp) {}
+
+    bool operator>(const StreamEvent& other) const {
+        return time > other.time;
+    }
+};
+
+// Statistics-only streaming model: same disciplines and random number
+// sequence as SimulationModel, but no per-request objects at all
+template <typename Engine>
+class BasicStreamingModel {
+private:
+    typedef BasicSource<Engine> Source;
+    typedef BasicStreamDevice<Engine> StreamDevice;
+
+    MonotonicArena arena; // sources, devices, buffer and selector (destroyed last)
+    priority_queue<StreamEvent, vector<StreamEvent>, greater<StreamEvent>> calendar;
+    vector<Source*> sources;
+    vector<StreamDevice*> devices;
+    StreamBuffer* buffer;
+    DeviceSelector* device_selector;
+    VariatePrefetcher* prefetcher; // nullptr - variates generated inline
+    vector<Engine> streams; // see makeModelStreams
+    ModelConfig config;
+
+    double current_time;
+    int current_serving_source;
+    SimulationStatistics stats;
+
+    Engine& streamOf(int entity) {
+        return streams[StreamFactory<Engine>::independent_streams ? entity : 0];
+    }
+
+    void startService(StreamDevice* device, const BufferSlot& request) {
+        double service_time = device->getServiceTime();
+        device->startService(request, current_time);
+        calendar.push(StreamEvent(current_time + service_time, Event::DEPARTURE, device->getId()));
+    }
+
+public:
+    BasicStreamingModel(const ModelConfig& model_config = ModelConfig())
+        : prefetcher(nullptr), streams(makeModelStreams<Engine>(model_config)), config(model_config),
+        current_time(0), current_serving_source(-1),
+        stats(model_config.getNumSources(), model_config.getNumDevices(), 0,
+            model_config.window_length, model_config.window_buckets) {
+
+        int num_sources = config.getNumSources();
+        for (int i = 0; i < num_sources; i++) {
+            sources.push_back(arena.create<Source>(i, config.source_min_intervals[i],
+                config.source_max_intervals[i], streamOf(i), config.sampler, config.arrivals));
+        }
+
+        int num_devices = config.getNumDevices();
+        for (int i = 0; i < num_devices; i++) {
+            devices.push_back(arena.create<StreamDevice>(i, config.device_mean_times[i],
+                streamOf(num_sources + i),
+                config.sampler));
+        }
+
+        buffer = arena.create<StreamBuffer>(config.buffer_size, BufferSlotSourceOf());
+        device_selector = arena.create<DeviceSelector>(num_devices);
+
+        // Sized as in SimulationModel, so the event loop never allocates
+        vector<StreamEvent> calendar_storage;
+        calendar_storage.reserve(num_sources + num_devices);
+        calendar = priority_queue<StreamEvent, vector<StreamEvent>, greater<StreamEvent>>(
+            greater<StreamEvent>(), move(calendar_storage));
+        stats.reserveOccupancy(num_devices + config.buffer_size, config.buffer_size);
+
+        if (config.prefetch && StreamFactory<Engine>::independent_streams) {
+            prefetcher = startPrefetcher(sources, devices);
+        }
+
+        for (int i = 0; i < num_sources; i++) {
+            double first_time = sources[i]->getNextInterval();
+            calendar.push(StreamEvent(first_time, Event::ARRIVAL, i));
+        }
+    }
+
+    ~BasicStreamingModel() {
+        delete prefetcher; // stops the producer before the entities go away
+    }
+
+    void processArrival(int source_id) {
+        stats.recordArrival(source_id, current_time);
+        BufferSlot request = { source_id, current_time };
+
+        double next_time = current_time + sources[source_id]->getNextInterval();
+        calendar.push(StreamEvent(next_time, Event::ARRIVAL, source_id));
+
+        StreamDevice* free_device = device_selector->getFreeDevice(devices);
+        if (free_device) {
+            stats.recordSystemChange(current_time, +1);
+            startService(free_device, request);
+        }
+        else {
+            BufferSlot rejected_request;
+            if (buffer->isFull() && buffer->findRequestToReject(rejected_request)) {
+                stats.recordRejection(rejected_request.source_id, rejected_request.arrival_time,
+                    current_time);
+                stats.recordBufferChange(rejected_request.source_id, current_time, -1);
+                stats.recordSystemChange(current_time, -1);
+            }
+            buffer->addRequest(request);
+            stats.recordBufferChange(source_id, current_time, +1);
+            stats.recordSystemChange(current_time, +1);
+        }
+    }
+
+    void processDeparture(int device_id) {
+        StreamDevice* device = devices[device_id];
+        device->finishService();
+        stats.recordDeparture(device->source_id, device_id, device->arrival_time,
+            device->start_service_time, current_time);
+        stats.recordSystemChange(current_time, -1);
+
+        BufferSlot next_request;
+        if (!buffer->isEmpty() && buffer->getNextRequest(current_serving_source, next_request)) {
+            stats.recordPacketDispatch(current_serving_source, current_time);
+            stats.recordBufferChange(next_request.source_id, current_time, -1);
+            StreamDevice* free_device = device_selector->getFreeDevice(devices);
+            if (free_device) {
+                startService(free_device, next_request);
+            }
+        }
+    }
+
+    // Event loop without any output; returns the number of processed events
+    long long simulate(double max_time, int max_requests) {
+        long long events = 0;
+        while (!calendar.empty() && current_time < max_time &&
+            stats.requests_served < max_requests) {
+            events++;
+
+            StreamEvent event = calendar.top();
+            calendar.pop();
+            current_time = event.time;
+
+            if (event.type == Event::ARRIVAL) {
+                processArrival(event.entity_id);
+            }
+            else {
+                processDeparture(event.entity_id);
+            }
+        }
+        return events;
+    }
+
+    // Discard everything counted so far (end of a warm-up period)
+    void resetStatistics() {
+        stats.restart(current_time);
+    }
+
+    const SimulationStatistics& getStatistics() const { return stats; }
+    double getCurrentTime() const { return current_time; }
+
+    void run(double max_time = 1000.0, int max_requests = 1000) {
+        printModelHeader("SIMULATION MODEL VARIANT 6 (STREAMING MODE)", config,
+            max_time, max_requests);
+        // Counters (--perf) cover the main loop only, inside its trace scope
+        unique_ptr<HardwareCounters> counters(config.perf_counters ? new HardwareCounters() : nullptr);
+        CounterValues values = {};
+        long long events;
+        {
+            ScopedTrace trace("main loop");
+            if (counters) counters->start();
+            events = simulate(max_time, max_requests);
+            if (counters) values = counters->stop();
+        }
+        ScopedTrace trace("reporting");
+        printResults();
+        if (counters) printRunCounters(*counters, values, events);
+    }
+
+    void printResults() {
+        stats.print(current_time, current_serving_source,
+            buffer->getMaxSize(), buffer->getSize());
+    }
+};
+
+typedef BasicStreamingModel<default_random_engine> StreamingModel;
+
+// Devices of the aggregated engines, grouped into classes of consecutive
+// devices in order of mean time, equal in size, each served at the reciprocal
+// of its mean service time (device_order, if given, receives the device ids
+// in that order)
+struct DeviceGroup {
+    int first_device; // position in order of mean time
+    int count;
+    double rate;
+
+    string getName() const {
+        string name = "D" + to_string(first_device + 1);
+        if (count > 1) name += "-D" + to_string(first_device + count);
+        return name;
+    }
+};
+
+vector<DeviceGroup> groupDevices(const ModelConfig& config, int max_groups,
+    vector<int>* device_order = nullptr) {
+    int num_devices = config.getNumDevices();
+    vector<int> order(num_devices);
+    for (int i = 0; i < num_devices; i++) order[i] = i;
+    stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return config.device_mean_times[a] < config.device_mean_times[b];
+    });
+
+    if (device_order) *device_order = order;
+
+    vector<DeviceGroup> groups;
+    int num_groups = min(num_devices, max_groups);
+    for (int k = 0; k < num_groups; k++) {
+        int first = (int)((long long)num_devices * k / num_groups);
+        int last = (int)((long long)num_devices * (k + 1) / num_groups);
+        double mean_sum = 0;
+        for (int i = first; i < last; i++) mean_sum += config.device_mean_times[order[i]];
+        groups.push_back(DeviceGroup{ first, last - first, (last - first) / mean_sum });
+    }
+    return groups;
+}
+
+// Approximate tau-leaping engine (--tau-leap) for Poisson sources and
+// exponential devices at extreme scale. The state is aggregated: requests of
+// each source in the buffer, and busy devices by device class and source
+// (at most MAX_CLASSES classes, see groupDevices). A leap of length tau draws
+// Poisson arrivals and binomial completions, then applies the disciplines to
+// the counts: freed devices take the buffer in packet order, arrivals take free
+// devices (spread over the classes like round-robin would), the rest enter the
+// buffer evicting the highest source. tau is chosen so that no busy count is
+// expected to change by more than epsilon of its value (Cao, Gillespie &
+// Petzold) and the buffer by more than epsilon of its capacity; when a leap
+// would cover fewer than EXACT_THRESHOLD events the engine takes exact
+// aggregated steps instead. Times come from Little's law
+class TauLeapModel {
+private:
+    static const int MAX_CLASSES = 32;
+    static const int EXACT_THRESHOLD = 10; // expected events below which steps are exact
+    static const int EXACT_STEPS = 100;    // exact steps taken per fallback
+
+    struct DeviceClass : DeviceGroup {
+        vector<long long> busy;     // busy devices, by source of their request
+        long long total_busy;
+        double busy_time;           // integral of total_busy
+    };
+
+    ModelConfig config;
+    Xoshiro256PlusPlus generator;
+    double epsilon;
+    vector<double> arrival_rates;
+    vector<DeviceClass> classes;
+    vector<long long> buffered;
+    long long buffer_total;
+    long long total_busy;
+    int num_devices;
+    int serving_source; // packet being served, -1 - none
+
+    double current_time;
+    vector<long long> source_requests;
+    vector<long long> source_rejections;
+    vector<long long> source_served;
+    vector<double> buffer_time;  // integral of buffered[s]
+    vector<double> service_time; // integral of requests of s in service
+    vector<long long> arrivals;  // arrivals of the current leap, by source (reused)
+    long long leaps;
+    long long exact_steps;
+
+    long long freeDevices() const { return num_devices - total_busy; }
+
+    // Start n services for source s on free devices, spread over the classes in
+    // proportion to their free devices (sequential hypergeometric split)
+    void startServices(int s, long long n) {
+        long long free_left = freeDevices();
+        for (auto& device_class : classes) {
+            if (n == 0) break;
+            long long free_here = device_class.count - device_class.total_busy;
+            if (free_here == 0) continue;
+            long long taken = n;
+            if (free_here < free_left) {
+                binomial_distribution<long long> split(n, (double)free_here / free_left);
+                taken = min(free_here, split(generator));
+                taken = max(taken, n - (free_left - free_here));
+            }
+            device_class.busy[s] += taken;
+            device_class.total_busy += taken;
+            total_busy += taken;
+            free_left -= free_here;
+            n -= taken;
+        }
+    }
+
+    // Free devices take buffered requests: the current packet's source first,
+    // then the lowest-numbered source present
+    void dispatchFromBuffer() {
+        long long slots = freeDevices();
+        while (slots > 0 && buffer_total > 0) {
+            if (serving_source == -1 || buffered[serving_source] == 0) {
+                serving_source = 0;
+                while (buffered[serving_source] == 0) serving_source++;
+            }
+            long long taken = min(slots, buffered[serving_source]);
+            buffered[serving_source] -= taken;
+            buffer_total -= taken;
+            startServices(serving_source, taken);
+            slots -= taken;
+        }
+    }
+
+    // Evict excess requests from the highest-numbered sources in the buffer,
+    // skipping the n newest of source except (each arrival displaces an older request)
+    void evict(long long excess, int except, long long n) {
+        for (int s = (int)buffered.size() - 1; s >= 0 && excess > 0; s--) {
+            long long evictable = buffered[s] - (s == except ? n : 0);
+            long long rejected = min(excess, max(0LL, evictable));
+            buffered[s] -= rejected;
+            buffer_total -= rejected;
+            source_rejections[s] += rejected;
+            excess -= rejected;
+        }
+    }
+
+    // n requests of source s enter the buffer; a full buffer rejects from the
+    // highest source already waiting, then from the newcomers themselves
+    void enterBuffer(int s, long long n) {
+        buffered[s] += n;
+        buffer_total += n;
+        long long excess = buffer_total - config.buffer_size;
+        if (excess > 0) evict(excess, s, n);
+        excess = buffer_total - config.buffer_size;
+        if (excess > 0) evict(excess, -1, 0);
+    }
+
+    // Time integrals of the piecewise-constant (exact step) or linearly
+    // interpolated (leap, weight 1/2 before and after) state
+    void integrate(double dt) {
+        for (size_t s = 0; s < buffered.size(); s++) {
+            buffer_time[s] += buffered[s] * dt;
+            long long in_service = 0;
+            for (const auto& device_class : classes) in_service += device_class.busy[s];
+            service_time[s] += in_service * dt;
+        }
+        for (auto& device_class : classes) device_class.busy_time += device_class.total_busy * dt;
+    }
+
+    double getArrivalRate() const {
+        double rate = 0;
+        for (double lambda : arrival_rates) rate += lambda;
+        return rate;
+    }
+
+    double getDepartureRate() const {
+        double rate = 0;
+        for (const auto& device_class : classes) rate += device_class.rate * device_class.total_busy;
+        return rate;
+    }
+
+    // Largest tau for which no busy count (what the propensities depend on) is
+    // expected to move by more than max(epsilon * count, 1), nor the buffer by
+    // more than max(epsilon * capacity, 1)
+    double selectTau() const {
+        double arrival_rate = getArrivalRate();
+        double departure_rate = getDepartureRate();
+        double tau = max(epsilon * config.buffer_size, 1.0) / (arrival_rate + departure_rate);
+        for (const auto& device_class : classes) {
+            double rate = device_class.rate * device_class.total_busy +
+                arrival_rate * device_class.count / num_devices;
+            if (rate > 0) tau = min(tau, max(epsilon * device_class.total_busy, 1.0) / rate);
+        }
+        return tau;
+    }
+
+    // One exact event of the aggregated process (false - no event before max_time)
+    bool exactStep(double max_time) {
+        double arrival_rate = getArrivalRate();
+        double total_rate = arrival_rate + getDepartureRate();
+        double dt = exponential_distribution<double>(total_rate)(generator);
+        if (current_time + dt >= max_time) {
+            integrate(max_time - current_time);
+            current_time = max_time;
+            return false;
+        }
+        integrate(dt);
+        current_time += dt;
+        exact_steps++;
+
+        double pick = uniformDouble(generator) * total_rate;
+        for (size_t s = 0; s < arrival_rates.size(); s++) {
+            if (pick < arrival_rates[s]) {
+                source_requests[s]++;
+                if (freeDevices() > 0) startServices((int)s, 1);
+                else enterBuffer((int)s, 1);
+                return true;
+            }
+            pick -= arrival_rates[s];
+        }
+
+        // A completion; rounding may leave pick past the end, then the last busy cell
+        DeviceClass* done_class = nullptr;
+        size_t done_source = 0;
+        for (auto& device_class : classes) {
+            for (size_t s = 0; s < device_class.busy.size(); s++) {
+                if (device_class.busy[s] == 0) continue;
+                done_class = &device_class;
+                done_source = s;
+                pick -= device_class.rate * device_class.busy[s];
+                if (pick < 0) break;
+            }
+            if (pick < 0) break;
+        }
+        if (done_class) {
+            done_class->busy[done_source]--;
+            done_class->total_busy--;
+            total_busy--;
+            source_served[done_source]++;
+            dispatchFromBuffer();
+        }
+        return true;
+    }
+
+    // One leap of length tau
+    void leap(double tau) {
+        integrate(tau / 2);
+
+        for (auto& device_class : classes) {
+            double p = -expm1(-device_class.rate * tau);
+            for (size_t s = 0; s < device_class.busy.size(); s++) {
+                if (device_class.busy[s] == 0) continue;
+                long long done = binomial_distribution<long long>(device_class.busy[s], p)(generator);
+                device_class.busy[s] -= done;
+                device_class.total_busy -= done;
+                total_busy -= done;
+                source_served[s] += done;
+            }
+        }
+        dispatchFromBuffer();
+
+        int num_sources = (int)arrival_rates.size();
+        long long total_arrivals = 0;
+        for (int s = 0; s < num_sources; s++) {
+            arrivals[s] = poisson_distribution<long long>(arrival_rates[s] * tau)(generator);
+            source_requests[s] += arrivals[s];
+            total_arrivals += arrivals[s];
+        }
+
+        // Arrivals in random order: the first ones find the free devices
+        long long direct_left = min(total_arrivals, freeDevices());
+        long long arrivals_left = total_arrivals;
+        for (int s = 0; s < num_sources && direct_left > 0; s++) {
+            long long direct = direct_left;
+            if (arrivals[s] < arrivals_left) {
+                binomial_distribution<long long> split(direct_left, (double)arrivals[s] / arrivals_left);
+                direct = min(arrivals[s], split(generator));
+                direct = max(direct, direct_left - (arrivals_left - arrivals[s]));
+            }
+            startServices(s, direct);
+            arrivals[s] -= direct;
+            arrivals_left -= arrivals[s] + direct;
+            direct_left -= direct;
+        }
+
+        // The rest enter the buffer, sources interleaved in slices
+        const int slices = 16;
+        for (int slice = 0; slice < slices; slice++) {
+            for (int s = 0; s < num_sources; s++) {
+                long long n = arrivals[s] / (slices - slice);
+                if (n > 0) enterBuffer(s, n);
+                arrivals[s] -= n;
+            }
+        }
+
+        integrate(tau / 2);
+        current_time += tau;
+        leaps++;
+    }
+
+public:
+    TauLeapModel(const ModelConfig& model_config, double tau_epsilon)
+        : config(model_config),
+        generator(StreamFactory<Xoshiro256PlusPlus>::make(model_config.resolveSeed(), model_config.replication, 0)),
+        epsilon(tau_epsilon), buffered(model_config.getNumSources(), 0), buffer_total(0), total_busy(0),
+        num_devices(model_config.getNumDevices()), serving_source(-1), current_time(0),
+        source_requests(model_config.getNumSources(), 0), source_rejections(model_config.getNumSources(), 0),
+        source_served(model_config.getNumSources(), 0), buffer_time(model_config.getNumSources(), 0),
+        service_time(model_config.getNumSources(), 0), arrivals(model_config.getNumSources(), 0),
+        leaps(0), exact_steps(0) {
+        int num_sources = config.getNumSources();
+        for (int s = 0; s < num_sources; s++) {
+            arrival_rates.push_back(2.0 / (config.source_min_intervals[s] + config.source_max_intervals[s]));
+        }
+
+        for (const DeviceGroup& group : groupDevices(config, MAX_CLASSES)) {
+            classes.push_back(DeviceClass{ group, vector<long long>(num_sources, 0), 0, 0 });
+        }
+    }
+
+    void simulate(double max_time) {
+        while (current_time < max_time) {
+            double tau = min(selectTau(), max_time - current_time);
+            if ((getArrivalRate() + getDepartureRate()) * tau < EXACT_THRESHOLD &&
+                current_time + tau < max_time) {
+                for (int step = 0; step < EXACT_STEPS; step++) {
+                    if (!exactStep(max_time)) break;
+                }
+            }
+            else {
+                leap(tau);
+            }
+        }
+    }
+
+    long long getLeaps() const { return leaps; }
+    long long getExactSteps() const { return exact_steps; }
+
+    // The figures of printResults, estimated from the aggregated state
+    void printResults() const {
+        long long generated = 0, rejected = 0, served = 0;
+        for (size_t s = 0; s < source_requests.size(); s++) {
+            generated += source_requests[s];
+            rejected += source_rejections[s];
+            served += source_served[s];
+        }
+
+        cout << "\n=== SIMULATION RESULTS (tau-leaping estimate) ===" << endl;
+        cout << "Total simulation time: " << current_time << " units" << endl;
+        cout << "Requests generated: " << generated << endl;
+        cout << "Requests served: " << served << endl;
+        cout << "Requests rejected: " << rejected << endl;
+
+        cout << "\n--- SOURCE CHARACTERISTICS ---" << endl;
+        cout << setw(10) << "Source" << setw(12) << "Requests"
+            << setw(12) << "Rejected" << setw(12) << "P_reject"
+            << setw(12) << "T_total" << setw(12) << "T_wait" << endl;
+        for (size_t s = 0; s < source_requests.size(); s++) {
+            // Little's law over the requests that were not rejected
+            double accepted = (double)(source_requests[s] - source_rejections[s]);
+            cout << setw(10) << "S" + to_string(s + 1)
+                << setw(12) << source_requests[s]
+                << setw(12) << source_rejections[s]
+                << setw(12) << fixed << setprecision(3)
+                << (source_requests[s] > 0 ? (double)source_rejections[s] / source_requests[s] : 0)
+                << setw(12) << fixed << setprecision(2)
+                << (accepted > 0 ? (buffer_time[s] + service_time[s]) / accepted : 0)
+                << setw(12) << fixed << setprecision(2) << (accepted > 0 ? buffer_time[s] / accepted : 0)
+                << endl;
+        }
+
+        cout << "\n--- DEVICE CHARACTERISTICS (by class) ---" << endl;
+        cout << setw(20) << "Devices" << setw(15) << "Utilization" << endl;
+        for (const auto& device_class : classes) {
+            cout << setw(20) << device_class.getName() << setw(15) << fixed << setprecision(3)
+                << (current_time > 0 ? device_class.busy_time / (device_class.count * current_time) : 0)
+                << endl;
+        }
+
+        cout << "\n--- DISCIPLINE ANALYSIS ---" << endl;
+        string current_packet = (serving_source == -1) ? "none" : "S" + to_string(serving_source + 1);
+        cout << "Packet service: Current packet = " << current_packet << endl;
+        cout << "Rejections: Total rejected = " << rejected << endl;
+        cout << "Buffer: Max size = " << config.buffer_size << ", Current size = " << buffer_total << endl;
+
+        double system_time = 0;
+        for (size_t s = 0; s < buffer_time.size(); s++) system_time += buffer_time[s] + service_time[s];
+        cout << "\n--- OCCUPANCY (time-weighted means) ---" << endl;
+        cout << "Requests in system: mean = " << setprecision(3) << system_time / current_time << endl;
+        for (size_t s = 0; s < buffer_time.size(); s++) {
+            cout << "S" << s + 1 << " buffer mean = " << buffer_time[s] / current_time << endl;
+        }
+    }
+};
+
+// Fluid (mean-field) engine (--fluid): with very many sources the model
+// approaches deterministic flows. The state is the buffer content of every
+// source class and the busy devices of every device class (groupDevices) by
+// source; the ODEs are integrated with step h. Flows over a step follow the
+// disciplines in the fluid limit:
+// - devices freed during the step first take buffer content; packets are short
+//   against a step, so the packet rule becomes sharing: the freed devices take
+//   the sources present in proportion to their content;
+// - arrivals take the devices still free, the rest waits in the buffer;
+// - a full buffer pushes out, for every excess unit, the highest source among
+//   buffer_size requests drawn from the buffer's mix (F_s^B - F_(s-1)^B with
+//   F_s the share of sources up to s), which tends to "the highest source
+//   present" for large buffers.
+// Completions of a class decay exactly (exp(-rate * h)). Buffer content of
+// every source is kept as FIFO cohorts by arrival time; service and push-outs
+// both take the oldest, so waits are measured on the content that actually
+// enters service (pushed-out content, like rejected requests in the event
+// model, has no wait). Deterministic flows have no congestion below capacity:
+// for small systems near or under saturation the event model's rejections and
+// waits come from fluctuations this engine does not see. Load may vary:
+// arrival rates are scaled by 1 + amplitude * sin(2 pi t / period)
+class FluidModel {
+private:
+    static const int MAX_CLASSES = 32;
+    static const int TRAJECTORY_POINTS = 10;
+    static const int MAX_COHORTS = 64; // per source; the newest two merge beyond it
+    static constexpr double MIN_CONTENT = 1e-12;
+
+    struct Cohort {
+        double arrival_time;
+        double amount;
+    };
+
+    ModelConfig config;
+    double step_size;
+    double amplitude;
+    double period; // 0 - constant load
+    vector<double> base_rates;
+    vector<DeviceGroup> groups;
+    vector<vector<double>> busy; // [group][source]
+    vector<double> buffered;
+    vector<deque<Cohort>> cohorts; // buffer content of each source, oldest first
+    double current_time;
+
+    vector<double> arrived;
+    vector<double> rejected;
+    vector<double> started;      // content that entered service (directly or from the buffer)
+    vector<double> completed;
+    vector<double> wait_time;    // waits of the content that entered service
+    vector<double> service_time; // integral of the busy devices serving s
+    vector<double> busy_time;    // integral of the busy devices of each group
+    vector<double> free_devices; // scratch of step()
+    vector<double> amounts;      // scratch of step(), by source
+    vector<double> done_fractions; // completed share of each group's busy devices in step_size
+    long long steps;
+
+    // Samples of the trajectory: time, load, buffer content, busy fraction
+    vector<vector<double>> trajectory;
+
+    double getLoad(double time) const {
+        return period > 0 ? 1.0 + amplitude * sin(2.0 * acos(-1.0) * time / period) : 1.0;
+    }
+
+    double getBusy(int k) const {
+        double total = 0;
+        for (double value : busy[k]) total += value;
+        return total;
+    }
+
+    // Takes amount of source s out of its oldest cohorts; returns the summed waits
+    double removeOldest(int s, double amount) {
+        double waits = 0;
+        deque<Cohort>& queue = cohorts[s];
+        while (amount > 0 && !queue.empty()) {
+            Cohort& oldest = queue.front();
+            double taken = min(amount, oldest.amount);
+            waits += taken * (current_time - oldest.arrival_time);
+            amount -= taken;
+            oldest.amount -= taken;
+            if (oldest.amount < MIN_CONTENT) queue.pop_front();
+        }
+        buffered[s] = 0;
+        for (const Cohort& cohort : queue) buffered[s] += cohort.amount;
+        return waits;
+    }
+
+    // Puts amount[s] of every source in service, spread over the device
+    // classes in proportion to their free devices
+    void startServices(double free_total) {
+        for (int s = 0; s < (int)amounts.size(); s++) {
+            if (amounts[s] <= 0 || free_total <= 0) continue;
+            double fraction = min(1.0, amounts[s] / free_total);
+            for (size_t k = 0; k < groups.size(); k++) {
+                double share = free_devices[k] * fraction;
+                busy[k][s] += share;
+                free_devices[k] -= share;
+            }
+            free_total -= amounts[s];
+            started[s] += amounts[s];
+        }
+    }
+
+    void step(double h) {
+        int num_sources = (int)buffered.size();
+        int num_groups = (int)groups.size();
+        double load = getLoad(current_time);
+
+        // Integrals over the step (state at its start)
+        for (int k = 0; k < num_groups; k++) {
+            busy_time[k] += getBusy(k) * h;
+            for (int s = 0; s < num_sources; s++) service_time[s] += busy[k][s] * h;
+        }
+
+        // Completions; capacity = free devices at the end of the step. Decayed
+        // contents below MIN_CONTENT are dropped (denormals would slow every step)
+        double capacity = 0;
+        for (int k = 0; k < num_groups; k++) {
+            double done_fraction = h == step_size ? done_fractions[k] : -expm1(-groups[k].rate * h);
+            for (int s = 0; s < num_sources; s++) {
+                double done = busy[k][s] * done_fraction;
+                completed[s] += done;
+                busy[k][s] -= done;
+                if (busy[k][s] < MIN_CONTENT) busy[k][s] = 0;
+            }
+            free_devices[k] = max(0.0, groups[k].count - getBusy(k));
+            capacity += free_devices[k];
+        }
+        current_time += h;
+
+        // Freed devices share the buffer content in proportion to it
+        double buffer_total = 0;
+        for (double value : buffered) buffer_total += value;
+        if (buffer_total > 0 && capacity > 0) {
+            double fraction = min(1.0, capacity / buffer_total);
+            double taken_total = 0;
+            for (int s = 0; s < num_sources; s++) {
+                amounts[s] = buffered[s] * fraction;
+                wait_time[s] += removeOldest(s, amounts[s]);
+                taken_total += amounts[s];
+            }
+            startServices(capacity);
+            capacity = max(0.0, capacity - taken_total);
+        }
+
+        // Arrivals take the devices still free, the rest enters the buffer
+        double inflow_total = 0;
+        for (int s = 0; s < num_sources; s++) {
+            amounts[s] = base_rates[s] * load * h;
+            arrived[s] += amounts[s];
+            inflow_total += amounts[s];
+        }
+        double direct_fraction = inflow_total > 0 ? min(1.0, capacity / inflow_total) : 0;
+        for (int s = 0; s < num_sources; s++) {
+            double waiting = amounts[s] * (1 - direct_fraction);
+            amounts[s] -= waiting;
+            if (waiting < MIN_CONTENT) continue;
+            deque<Cohort>& queue = cohorts[s];
+            queue.push_back({ current_time - h / 2, waiting });
+            if (queue.size() > MAX_COHORTS) {
+                Cohort newest = queue.back();
+                queue.pop_back();
+                Cohort& previous = queue.back();
+                previous.arrival_time = (previous.arrival_time * previous.amount + newest.arrival_time * newest.amount) /
+                    (previous.amount + newest.amount);
+                previous.amount += newest.amount;
+            }
+            buffered[s] += waiting;
+        }
+        startServices(capacity);
+
+        // Push-outs: each excess unit leaves the highest of buffer_size requests
+        // drawn from the buffer's mix
+        buffer_total = 0;
+        for (double value : buffered) buffer_total += value;
+        double excess = buffer_total - config.buffer_size;
+        if (excess > 0) {
+            double below = 0, cumulative = 0, left = excess;
+            for (int s = 0; s < num_sources; s++) {
+                cumulative += buffered[s] / buffer_total;
+                double up_to = pow(min(1.0, cumulative), config.buffer_size);
+                amounts[s] = min(buffered[s], excess * (up_to - below));
+                below = up_to;
+                left -= amounts[s];
+            }
+            // What a source could not give comes from the highest sources left
+            for (int s = num_sources - 1; s >= 0 && left > MIN_CONTENT; s--) {
+                double extra = min(left, buffered[s] - amounts[s]);
+                amounts[s] += extra;
+                left -= extra;
+            }
+            for (int s = 0; s < num_sources; s++) {
+                if (amounts[s] <= 0) continue;
+                removeOldest(s, amounts[s]);
+                rejected[s] += amounts[s];
+            }
+        }
+        steps++;
+    }
+
+public:
+    FluidModel(const ModelConfig& model_config, double h, double load_amplitude, double load_period)
+        : config(model_config), step_size(h), amplitude(load_amplitude), period(load_period),
+        groups(groupDevices(model_config, MAX_CLASSES)),
+        busy(groups.size(), vector<double>(model_config.getNumSources(), 0)),
+        buffered(model_config.getNumSources(), 0), cohorts(model_config.getNumSources()), current_time(0),
+        arrived(model_config.getNumSources(), 0), rejected(model_config.getNumSources(), 0),
+        started(model_config.getNumSources(), 0), completed(model_config.getNumSources(), 0),
+        wait_time(model_config.getNumSources(), 0), service_time(model_config.getNumSources(), 0),
+        busy_time(groups.size(), 0), free_devices(groups.size(), 0), amounts(model_config.getNumSources(), 0),
+        steps(0) {
+        for (int s = 0; s < config.getNumSources(); s++) {
+            base_rates.push_back(2.0 / (config.source_min_intervals[s] + config.source_max_intervals[s]));
+        }
+        for (const DeviceGroup& group : groups) done_fractions.push_back(-expm1(-group.rate * step_size));
+    }
+
+    void simulate(double max_time) {
+        double next_sample = 0;
+        while (current_time < max_time) {
+            if (current_time >= next_sample) {
+                double buffer_total = 0, busy_total = 0;
+                for (double value : buffered) buffer_total += value;
+                for (size_t k = 0; k < groups.size(); k++) busy_total += getBusy((int)k);
+                trajectory.push_back({ current_time, getLoad(current_time), buffer_total,
+                    busy_total / config.getNumDevices() });
+                next_sample += max_time / TRAJECTORY_POINTS;
+            }
+            step(min(step_size, max_time - current_time));
+        }
+    }
+
+    long long getSteps() const { return steps; }
+    const vector<DeviceGroup>& getGroups() const { return groups; }
+
+    double getRejectProbability(int s) const { return arrived[s] > 0 ? rejected[s] / arrived[s] : 0; }
+
+    // Some content of s entered service (the times below are defined)
+    bool hasThroughput(int s) const { return started[s] > 1e-9 * max(1.0, arrived[s]); }
+
+    double getAverageWaitingTime(int s) const { return hasThroughput(s) ? wait_time[s] / started[s] : 0; }
+
+    double getAverageTotalTime(int s) const {
+        return getAverageWaitingTime(s) + (completed[s] > 0 ? service_time[s] / completed[s] : 0);
+    }
+
+    double getUtilization(int k) const {
+        return current_time > 0 ? busy_time[k] / (groups[k].count * current_time) : 0;
+    }
+
+    void printTrajectory() const {
+        cout << "\n--- FLUID TRAJECTORY ---" << endl;
+        cout << setw(12) << "Time" << setw(10) << "Load" << setw(12) << "Buffer" << setw(12) << "Busy" << endl;
+        for (const auto& point : trajectory) {
+            cout << setw(12) << fixed << setprecision(1) << point[0]
+                << setw(10) << setprecision(3) << point[1]
+                << setw(12) << setprecision(3) << point[2]
+                << setw(12) << setprecision(3) << point[3] << endl;
+        }
+    }
+};
+
+// Dense matrix for the matrix-analytic solver
+class Matrix {
+private:
+    int rows;
+    int cols;
+    vector<double> data;
+
+public:
+    Matrix(int num_rows = 0, int num_cols = 0) : rows(num_rows), cols(num_cols), data((size_t)num_rows * num_cols, 0) {}
+
+    static Matrix identity(int n) {
+        Matrix result(n, n);
+        for (int i = 0; i < n; i++) result(i, i) = 1;
+        return result;
+    }
+
+    int getRows() const { return rows; }
+    int getCols() const { return cols; }
+
+    double& operator()(int i, int j) { return data[(size_t)i * cols + j]; }
+    double operator()(int i, int j) const { return data[(size_t)i * cols + j]; }
+
+    Matrix operator*(const Matrix& other) const {
+        Matrix result(rows, other.cols);
+        for (int i = 0; i < rows; i++) {
+            for (int k = 0; k < cols; k++) {
+                double a = (*this)(i, k);
+                if (a == 0) continue;
+                for (int j = 0; j < other.cols; j++) result(i, j) += a * other(k, j);
+            }
+        }
+        return result;
+    }
+
+    Matrix operator+(const Matrix& other) const {
+        Matrix result = *this;
+        for (size_t i = 0; i < data.size(); i++) result.data[i] += other.data[i];
+        return result;
+    }
+
+    Matrix operator-(const Matrix& other) const {
+        Matrix result = *this;
+        for (size_t i = 0; i < data.size(); i++) result.data[i] -= other.data[i];
+        return result;
+    }
+
+    Matrix operator*(double factor) const {
+        Matrix result = *this;
+        for (double& value : result.data) value *= factor;
+        return result;
+    }
+
+    double maxAbs() const {
+        double result = 0;
+        for (double value : data) result = max(result, fabs(value));
+        return result;
+    }
+
+    // Row sums (the matrix times a column of ones)
+    vector<double> rowSums() const {
+        vector<double> sums(rows, 0);
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++) sums[i] += (*this)(i, j);
+        }
+        return sums;
+    }
+
+    // Gauss-Jordan inverse with partial pivoting
+    Matrix inverse() const {
+        int n = rows;
+        Matrix a = *this;
+        Matrix result = identity(n);
+        for (int col = 0; col < n; col++) {
+            int pivot = col;
+            for (int i = col + 1; i < n; i++) {
+                if (fabs(a(i, col)) > fabs(a(pivot, col))) pivot = i;
+            }
+            if (a(pivot, col) == 0) throw runtime_error("Matrix: singular");
+            for (int j = 0; j < n; j++) {
+                swap(a(col, j), a(pivot, j));
+                swap(result(col, j), result(pivot, j));
+            }
+            double scale = 1.0 / a(col, col);
+            for (int j = 0; j < n; j++) {
+                a(col, j) *= scale;
+                result(col, j) *= scale;
+            }
+            for (int i = 0; i < n; i++) {
+                double factor = a(i, col);
+                if (i == col || factor == 0) continue;
+                for (int j = 0; j < n; j++) {
+                    a(i, j) -= factor * a(col, j);
+                    result(i, j) -= factor * result(col, j);
+                }
+            }
+        }
+        return result;
+    }
+};
+
+// Matrix-analytic solver (--qbd) of the exponential variant with a large
+// buffer. What is counted in total (not by source) does not depend on which
+// sources wait: an arrival takes a free device (round-robin) or a buffer slot,
+// a full buffer swaps one waiting request for the newcomer, and a completion
+// with a non-empty buffer starts the next request on the device it freed. So
+// (buffer length; busy mask and round-robin pointer) is a finite quasi-birth-
+// death process: level n = buffer length, phases = masks x pointers at level 0
+// and the pointer alone above it (every device is busy). With A0 (up), A1
+// (local) and A2 (down), the levels 1..B are
+//     pi_n = v R^(n-1) + w S^(B-n)
+// where R and S are the minimal solutions of A0 + R A1 + R^2 A2 = 0 and
+// A2 + S A1 + S^2 A0 = 0, both from G matrices by logarithmic reduction
+// (Latouche & Ramaswami). Level 0 has 2^D x D phases, so it is not solved
+// densely: its generator is block tridiagonal in the number of busy devices
+// (blocks of C(D, k) x D phases), and block elimination gives pi_0 = pi_1 K.
+// That leaves v and w to the boundary equations of levels 1 and B. Per-source
+// figures would need the counts by source, whose phases grow with the buffer,
+// so they are left to the other engines
+class QbdSolver {
+private:
+    static const int MAX_DEVICES = 7; // level-0 blocks up to 35 x 7 phases: tens of ms
+    static const int MAX_ITERATIONS = 64;
+
+    int num_devices;
+    int buffer_size;
+    double arrival_rate;
+    vector<double> service_rates;
+    vector<vector<int>> level0_masks; // masks by busy count, phase = position * D + pointer
+    vector<int> mask_position;
+
+    vector<Matrix> level0_local, level0_up, level0_down; // blocks of level 0 by busy count
+    Matrix a0, a1, a2, last_local;
+    Matrix r, s;
+    int iterations;
+
+    // Minimal solution of down + local G + up G^2 = 0 by logarithmic reduction
+    Matrix logarithmicReduction(const Matrix& up, const Matrix& local, const Matrix& down, int& steps) const {
+        int m = local.getRows();
+        Matrix negative_local_inverse = (local * -1.0).inverse();
+        Matrix b_up = negative_local_inverse * up;
+        Matrix b_down = negative_local_inverse * down;
+        Matrix g = b_down;
+        Matrix t = b_up;
+        for (steps = 1; steps <= MAX_ITERATIONS; steps++) {
+            Matrix u = b_up * b_down + b_down * b_up;
+            Matrix inverse = (Matrix::identity(m) - u).inverse();
+            b_up = inverse * (b_up * b_up);
+            b_down = inverse * (b_down * b_down);
+            Matrix increment = t * b_down;
+            g = g + increment;
+            t = t * b_up;
+            if (increment.maxAbs() < 1e-15 || t.maxAbs() < 1e-15) break;
+        }
+        return g;
+    }
+
+    // Level-0 index after an arrival takes a free device (DeviceSelector order)
+    int takeFreeDevice(int mask, int pointer) const {
+        for (int i = 0; i < num_devices; i++) {
+            int idx = (pointer + 1 + i) % num_devices;
+            if (!(mask & (1 << idx))) return (mask | (1 << idx)) * num_devices + idx;
+        }
+        return -1;
+    }
+
+public:
+    // Stationary solution; see isSupported for the limits
+    double p_full;        // buffer full: an arrival causes a rejection
+    double mean_buffered;
+    vector<double> utilization;
+
+    QbdSolver(const ModelConfig& config)
+        : num_devices(config.getNumDevices()), buffer_size(config.buffer_size),
+        arrival_rate(0), iterations(0), p_full(0), mean_buffered(0) {
+        for (int i = 0; i < config.getNumSources(); i++) {
+            arrival_rate += 2.0 / (config.source_min_intervals[i] + config.source_max_intervals[i]);
+        }
+        for (double mean : config.device_mean_times) service_rates.push_back(1.0 / mean);
+    }
+
+    bool isSupported() const {
+        return num_devices >= 1 && num_devices <= MAX_DEVICES && buffer_size >= 1;
+    }
+
+    int getIterations() const { return iterations; }
+
+    void solve() {
+        int m = num_devices;
+        int full = (1 << m) - 1;
+        double total_service = 0;
+        for (double mu : service_rates) total_service += mu;
+
+        // Level 0 grouped by busy count k: an arrival moves to k + 1 (to level 1
+        // from k = D), a completion to k - 1
+        level0_masks.assign(m + 1, vector<int>());
+        mask_position.assign(full + 1, 0);
+        for (int mask = 0; mask <= full; mask++) {
+            int busy = 0;
+            for (int j = 0; j < m; j++) busy += (mask >> j) & 1;
+            mask_position[mask] = (int)level0_masks[busy].size();
+            level0_masks[busy].push_back(mask);
+        }
+        auto phase = [&](int mask, int pointer) { return mask_position[mask] * m + pointer; };
+        level0_local.assign(m + 1, Matrix());
+        level0_up.assign(m + 1, Matrix());
+        level0_down.assign(m + 1, Matrix());
+        for (int k = 0; k <= m; k++) {
+            int size = (int)level0_masks[k].size() * m;
+            level0_local[k] = Matrix(size, size);
+            if (k < m) level0_up[k] = Matrix(size, (int)level0_masks[k + 1].size() * m);
+            if (k > 0) level0_down[k] = Matrix(size, (int)level0_masks[k - 1].size() * m);
+            for (int mask : level0_masks[k]) {
+                for (int pointer = 0; pointer < m; pointer++) {
+                    int from = phase(mask, pointer);
+                    if (k < m) {
+                        int to = takeFreeDevice(mask, pointer);
+                        level0_up[k](from, phase(to / m, to % m)) += arrival_rate;
+                    }
+                    double out = arrival_rate;
+                    for (int j = 0; j < m; j++) {
+                        if (!(mask & (1 << j))) continue;
+                        level0_down[k](from, phase(mask & ~(1 << j), pointer)) += service_rates[j];
+                        out += service_rates[j];
+                    }
+                    level0_local[k](from, from) -= out;
+                }
+            }
+        }
+
+        // Levels 1..B: pointer only; a completion at j restarts device j (pointer j)
+        a0 = Matrix::identity(m) * arrival_rate;
+        a1 = Matrix::identity(m) * -(arrival_rate + total_service);
+        a2 = Matrix(m, m);
+        for (int p = 0; p < m; p++) {
+            for (int j = 0; j < m; j++) a2(p, j) = service_rates[j];
+        }
+        last_local = Matrix::identity(m) * -total_service; // arrivals at level B are rejections
+
+        // pi_0 = pi_1 K from the level-0 balance K B00 = -B10, where B10 only
+        // enters the all-busy block (phase = pointer). Sweeping up the busy count,
+        // K_k = K_(k+1) M_k with M_k = -down_(k+1) S_k^-1 and the Schur complements
+        // S_0 = local_0, S_k = M_(k-1) up_(k-1) + local_k; then K_D = -B10 S_D^-1
+        vector<Matrix> eliminated(m);
+        Matrix schur = level0_local[0];
+        for (int k = 0; k < m; k++) {
+            eliminated[k] = level0_down[k + 1] * schur.inverse() * -1.0;
+            // up_k has one entry per row (the device the arrival takes): scatter M_k up_k
+            schur = level0_local[k + 1];
+            const Matrix& up = level0_up[k];
+            for (int from = 0; from < up.getRows(); from++) {
+                int to = 0;
+                while (up(from, to) == 0) to++;
+                for (int i = 0; i < schur.getRows(); i++) schur(i, to) += eliminated[k](i, from) * up(from, to);
+            }
+        }
+        vector<Matrix> k_blocks(m + 1);
+        k_blocks[m] = a2 * -1.0 * schur.inverse();
+        for (int k = m - 1; k >= 0; k--) k_blocks[k] = k_blocks[k + 1] * eliminated[k];
+        Matrix level0_to_1 = k_blocks[m] * arrival_rate; // pi_0 B01 = pi_1 K_D lambda
+        vector<double> level0_ones(m, 0);
+        for (const Matrix& block : k_blocks) {
+            vector<double> ones = block.rowSums();
+            for (int i = 0; i < m; i++) level0_ones[i] += ones[i];
+        }
+
+        int steps_g = 0, steps_h = 0;
+        Matrix g = logarithmicReduction(a0, a1, a2, steps_g);
+        Matrix h = logarithmicReduction(a2, a1, a0, steps_h);
+        iterations = max(steps_g, steps_h);
+        r = a0 * (a1 * -1.0 - a0 * g).inverse();
+        s = a2 * (a1 * -1.0 - a2 * h).inverse();
+
+        // Powers and sums of R^k and S^k, k = 0..B-1
+        int levels = buffer_size;
+        vector<Matrix> r_power(2), s_power(2);
+        Matrix r_k = Matrix::identity(m), s_k = Matrix::identity(m);
+        Matrix r_sum(m, m), s_sum(m, m), r_weighted(m, m), s_weighted(m, m);
+        Matrix r_last, s_last, r_before_last, s_before_last;
+        for (int k = 0; k < levels; k++) {
+            if (k < 2) {
+                r_power[k] = r_k;
+                s_power[k] = s_k;
+            }
+            if (k == levels - 2) {
+                r_before_last = r_k;
+                s_before_last = s_k;
+            }
+            if (k == levels - 1) {
+                r_last = r_k;
+                s_last = s_k;
+            }
+            r_sum = r_sum + r_k;
+            s_sum = s_sum + s_k;
+            r_weighted = r_weighted + r_k * (double)(k + 1);        // level k + 1
+            s_weighted = s_weighted + s_k * (double)(levels - k);   // level B - k
+            r_k = r_k * r;
+            s_k = s_k * s;
+        }
+
+        // pi_n as rows of x = [v | w]: level n (1..B) is v R^(n-1) + w S^(B-n)
+        bool two_terms = levels > 1;
+        int unknowns = m + (two_terms ? m : 0);
+        auto levelRows = [&](int n) {
+            Matrix rows(unknowns, m);
+            const Matrix& rv = n - 1 == 0 ? r_power[0] : n - 1 == 1 ? r_power[1] :
+                n - 1 == levels - 2 ? r_before_last : r_last;
+            for (int i = 0; i < m; i++) for (int j = 0; j < m; j++) rows(i, j) = rv(i, j);
+            if (two_terms) {
+                int k = levels - n;
+                const Matrix& sw = k == 0 ? s_power[0] : k == 1 ? s_power[1] :
+                    k == levels - 2 ? s_before_last : s_last;
+                for (int i = 0; i < m; i++) for (int j = 0; j < m; j++) rows(m + i, j) = sw(i, j);
+            }
+            return rows;
+        };
+        Matrix level1_rows = levelRows(1);
+
+        // Balance equations x E = 0 (columns: level 1, level B if B > 1)
+        vector<Matrix> blocks;
+        if (two_terms) {
+            blocks.push_back(level1_rows * (level0_to_1 + a1) + levelRows(2) * a2);
+            blocks.push_back(levelRows(levels - 1) * a0 + levelRows(levels) * last_local);
+        }
+        else {
+            blocks.push_back(level1_rows * (level0_to_1 + last_local));
+        }
+
+        // Transposed system; the first equation is replaced by the normalization
+        Matrix system(unknowns, unknowns);
+        int column = 0;
+        for (const Matrix& block : blocks) {
+            for (int j = 0; j < block.getCols() && column < unknowns; j++, column++) {
+                for (int i = 0; i < unknowns; i++) system(column, i) = block(i, j);
+            }
+        }
+        vector<double> r_ones = r_sum.rowSums(), s_ones = s_sum.rowSums();
+        for (int i = 0; i < unknowns; i++) {
+            double level0_total = 0;
+            for (int j = 0; j < m; j++) level0_total += level1_rows(i, j) * level0_ones[j];
+            system(0, i) = level0_total + (i < m ? r_ones[i] : s_ones[i - m]);
+        }
+        Matrix inverse = system.inverse();
+        vector<double> x(unknowns);
+        for (int i = 0; i < unknowns; i++) x[i] = inverse(i, 0);
+
+        // Figures from the solution
+        auto weigh = [&](const Matrix& v_part, const Matrix& w_part) {
+            vector<double> v_ones = v_part.rowSums();
+            vector<double> w_ones = w_part.rowSums();
+            double total = 0;
+            for (int i = 0; i < m; i++) {
+                total += x[i] * v_ones[i];
+                if (two_terms) total += x[m + i] * w_ones[i];
+            }
+            return total;
+        };
+        p_full = weigh(r_last, s_power[0]);
+        mean_buffered = weigh(r_weighted, s_weighted);
+        double all_busy = weigh(r_sum, s_sum);
+        utilization.assign(m, all_busy);
+        Matrix pi_1(1, m);
+        for (int i = 0; i < unknowns; i++) {
+            for (int j = 0; j < m; j++) pi_1(0, j) += x[i] * level1_rows(i, j);
+        }
+        for (int k = 0; k <= m; k++) {
+            Matrix pi_0 = pi_1 * k_blocks[k];
+            for (int mask : level0_masks[k]) {
+                for (int pointer = 0; pointer < m; pointer++) {
+                    for (int j = 0; j < m; j++) {
+                        if (mask & (1 << j)) utilization[j] += pi_0(0, phase(mask, pointer));
+                    }
+                }
+            }
+        }
+    }
+
+    double getArrivalRate() const { return arrival_rate; }
+};
+
+// Phase-type distribution PH(alpha, T): time to absorption of a Markov chain
+// started in transient phase i with probability alpha[i], T the generator
+// among the transient phases (exit rates are minus its row sums). The
+// Markovian input form the analytical engines need
+class PhaseType {
+private:
+    vector<double> alpha;
+    Matrix generator;
+    string description;
+
+public:
+    PhaseType(const vector<double>& initial = vector<double>(1, 1.0), const Matrix& transient = Matrix::identity(1) * -1.0,
+        const string& text = "exponential")
+        : alpha(initial), generator(transient), description(text) {
+    }
+
+    // Mixture of Erlang branches (weight, shape, rate), phases of a branch in a chain
+    static PhaseType hyperErlang(const vector<double>& weights, const vector<int>& shapes,
+        const vector<double>& rates, const string& text) {
+        int phases = 0;
+        for (int shape : shapes) phases += shape;
+        vector<double> initial(phases, 0);
+        Matrix transient(phases, phases);
+        int first = 0;
+        for (size_t b = 0; b < shapes.size(); b++) {
+            initial[first] = weights[b];
+            for (int i = first; i < first + shapes[b]; i++) {
+                transient(i, i) = -rates[b];
+                if (i + 1 < first + shapes[b]) transient(i, i + 1) = rates[b];
+            }
+            first += shapes[b];
+        }
+        return PhaseType(initial, transient, text);
+    }
+
+    int getPhases() const { return (int)alpha.size(); }
+    const vector<double>& getInitial() const { return alpha; }
+    const Matrix& getGenerator() const { return generator; }
+    const string& getDescription() const { return description; }
+
+    // E[X^k] = k! alpha (-T)^-k 1
+    double getMoment(int k) const {
+        Matrix inverse = (generator * -1.0).inverse();
+        vector<double> row = alpha;
+        double factorial = 1;
+        for (int step = 1; step <= k; step++) {
+            vector<double> next(row.size(), 0);
+            for (size_t i = 0; i < row.size(); i++) {
+                if (row[i] == 0) continue;
+                for (size_t j = 0; j < row.size(); j++) next[j] += row[i] * inverse((int)i, (int)j);
+            }
+            row = next;
+            factorial *= step;
+        }
+        double total = 0;
+        for (double value : row) total += value;
+        return factorial * total;
+    }
+
+    // CDF at ascending points: the phase vector alpha exp(T x) is carried from
+    // point to point by uniformization
+    vector<double> getCdf(const vector<double>& points) const {
+        int n = getPhases();
+        double q = 0;
+        for (int i = 0; i < n; i++) q = max(q, -generator(i, i));
+        Matrix jump = Matrix::identity(n) + generator * (1.0 / q);
+
+        vector<double> row = alpha, cdf;
+        double x = 0;
+        for (double point : points) {
+            double remaining = point - x;
+            while (remaining > 0) {
+                double dt = min(remaining, 50.0 / q); // keeps exp(-q dt) far from underflow
+                double weight = exp(-q * dt), cumulative = weight;
+                vector<double> term = row, next(n, 0);
+                for (int i = 0; i < n; i++) next[i] = weight * term[i];
+                for (int k = 1; cumulative < 1 - 1e-13 && k < 1000; k++) {
+                    vector<double> product(n, 0);
+                    for (int i = 0; i < n; i++) {
+                        if (term[i] == 0) continue;
+                        for (int j = 0; j < n; j++) product[j] += term[i] * jump(i, j);
+                    }
+                    term.swap(product);
+                    weight *= q * dt / k;
+                    cumulative += weight;
+                    for (int i = 0; i < n; i++) next[i] += weight * term[i];
+                }
+                row.swap(next);
+                remaining -= dt;
+            }
+            x = point;
+            double survival = 0;
+            for (double value : row) survival += value;
+            cdf.push_back(1 - survival);
+        }
+        return cdf;
+    }
+};
+
+// Moment matching of mean and SCV (Tijms): a mixed Erlang(k-1, k) with a
+// common rate for SCV < 1 (k = ceil(1/SCV), capped at max_phases), the
+// exponential for SCV = 1 and a balanced-means H2 above
+PhaseType fitPhaseTypeMoments(double mean, double scv, int max_phases = 200) {
+    ostringstream text;
+    if (scv >= 1 - 1e-12 && scv <= 1 + 1e-12) {
+        text << "exponential, rate " << 1 / mean;
+        return PhaseType::hyperErlang({ 1.0 }, { 1 }, { 1 / mean }, text.str());
+    }
+    if (scv > 1) {
+        double p = 0.5 * (1 + sqrt((scv - 1) / (scv + 1)));
+        text << "H2, p " << p << ", rates " << 2 * p / mean << " / " << 2 * (1 - p) / mean;
+        return PhaseType::hyperErlang({ p, 1 - p }, { 1, 1 }, { 2 * p / mean, 2 * (1 - p) / mean }, text.str());
+    }
+
+    int k = max(2, min(max_phases, (int)ceil(1 / scv - 1e-9)));
+    double target = max(scv, 1.0 / k); // the closest SCV k phases can reach
+    double p = (k * target - sqrt(k * (1 + target) - k * k * target)) / (1 + target);
+    p = max(0.0, min(1.0, p));
+    double rate = (k - p) / mean;
+
+    // Chain of k phases entered at the second one with probability p (Erlang k-1)
+    vector<double> initial(k, 0);
+    initial[0] = 1 - p;
+    initial[1] = p;
+    Matrix transient(k, k);
+    for (int i = 0; i < k; i++) {
+        transient(i, i) = -rate;
+        if (i + 1 < k) transient(i, i + 1) = rate;
+    }
+    text << "mixed Erlang(" << k - 1 << "/" << k << "), p " << p << ", rate " << rate;
+    return PhaseType(initial, transient, text.str());
+}
+
+// Maximum-likelihood hyper-Erlang fit to samples by EM (Thuemmler, Buchholz &
+// Telek): for every shape vector of at most two branches with at most
+// max_phases phases in all, weights and rates are iterated to convergence;
+// the best likelihood wins
+PhaseType fitPhaseTypeEm(const vector<double>& samples, int max_phases, double& log_likelihood) {
+    const int max_iterations = 200;
+    vector<double> sorted(samples);
+    sort(sorted.begin(), sorted.end());
+    double n = (double)samples.size();
+    double sum = 0, log_sum = 0;
+    for (double x : samples) {
+        sum += x;
+        log_sum += log(x);
+    }
+
+    log_likelihood = -numeric_limits<double>::infinity();
+    PhaseType best;
+
+    // One branch: the rate has a closed form
+    for (int shape = 1; shape <= max_phases; shape++) {
+        double rate = shape * n / sum;
+        double ll = n * (shape * log(rate) - lgamma(shape)) + (shape - 1) * log_sum - rate * sum;
+        if (ll > log_likelihood) {
+            log_likelihood = ll;
+            ostringstream text;
+            text << "Erlang(" << shape << "), rate " << rate;
+            best = PhaseType::hyperErlang({ 1.0 }, { shape }, { rate }, text.str());
+        }
+    }
+
+    // Two branches, started from the lower and upper halves of the sample
+    size_t half = sorted.size() / 2;
+    double lower_mean = 0, upper_mean = 0;
+    for (size_t i = 0; i < sorted.size(); i++) (i < half ? lower_mean : upper_mean) += sorted[i];
+    lower_mean /= max<size_t>(1, half);
+    upper_mean /= max<size_t>(1, sorted.size() - half);
+
+    vector<double> responsibility(samples.size());
+    for (int first = 1; first < max_phases; first++) {
+        for (int second = first; first + second <= max_phases; second++) {
+            int shapes[2] = { first, second };
+            double weights[2] = { 0.5, 0.5 };
+            double rates[2] = { first / lower_mean, second / upper_mean };
+            double ll = -numeric_limits<double>::infinity();
+
+            for (int iteration = 0; iteration < max_iterations; iteration++) {
+                double previous = ll;
+                double weight_sum = 0, weighted_x = 0;
+                ll = 0;
+                double constants[2];
+                for (int b = 0; b < 2; b++) {
+                    constants[b] = log(weights[b]) + shapes[b] * log(rates[b]) - lgamma(shapes[b]);
+                }
+                for (size_t i = 0; i < samples.size(); i++) {
+                    double x = samples[i], lx = log(x);
+                    double l0 = constants[0] + (shapes[0] - 1) * lx - rates[0] * x;
+                    double l1 = constants[1] + (shapes[1] - 1) * lx - rates[1] * x;
+                    double top = max(l0, l1);
+                    double total = top + log(exp(l0 - top) + exp(l1 - top));
+                    responsibility[i] = exp(l0 - total);
+                    ll += total;
+                    weight_sum += responsibility[i];
+                    weighted_x += responsibility[i] * x;
+                }
+                weights[0] = weight_sum / n;
+                weights[1] = 1 - weights[0];
+                if (weights[0] < 1e-9 || weights[1] < 1e-9) break; // a branch died out
+                rates[0] = shapes[0] * weight_sum / weighted_x;
+                rates[1] = shapes[1] * (n - weight_sum) / (sum - weighted_x);
+                if (fabs(ll - previous) < 1e-9 * fabs(ll)) break;
+            }
+
+            if (ll > log_likelihood && weights[0] >= 1e-9 && weights[1] >= 1e-9) {
+                log_likelihood = ll;
+                ostringstream text;
+                text << "hyper-Erlang " << weights[0] << " x Erlang(" << first << ", " << rates[0]
+                    << ") + " << weights[1] << " x Erlang(" << second << ", " << rates[1] << ")";
+                best = PhaseType::hyperErlang({ weights[0], weights[1] }, { first, second },
+                    { rates[0], rates[1] }, text.str());
+            }
+        }
+    }
+    return best;
+}
+
+// Kolmogorov-Smirnov distance between a fitted distribution and sorted samples
+double ksDistance(const PhaseType& fit, const vector<double>& sorted) {
+    vector<double> cdf = fit.getCdf(sorted);
+    double n = (double)sorted.size(), distance = 0;
+    for (size_t i = 0; i < sorted.size(); i++) {
+        distance = max(distance, max(fabs(cdf[i] - i / n), fabs(cdf[i] - (i + 1) / n)));
+    }
+    return distance;
+}
+
+// Number of worker threads runParallel uses for count tasks
+int parallelWorkers(int count) {
+    return max(1, min(count, (int)thread::hardware_concurrency()));
+}
+
+// Run task(worker, 0), ..., task(worker, count - 1) on a pool of worker threads;
+// worker (0 .. parallelWorkers(count) - 1) indexes per-worker reusable state
+void runParallelWorkers(int count, const function<void(int, int)>& task) {
+    int num_threads = parallelWorkers(count);
+    atomic<int> next_index(0);
+    vector<thread> workers;
+    for (int t = 0; t < num_threads; t++) {
+        workers.push_back(thread([&, t]() {
+            for (int i = next_index++; i < count; i = next_index++) task(t, i);
+        }));
+    }
+    for (auto& worker : workers) worker.join();
+}
+
+// Run task(0), ..., task(count - 1) on a pool of worker threads
+void runParallel(int count, const function<void(int)>& task) {
+    runParallelWorkers(count, [&](int, int i) { task(i); });
+}
+
+// Perfect sampler (coupling from the past, Propp & Wilson) of the stationary
+// state of the exponential variant: Poisson sources, exponential devices.
+// The uniformized chain moves by one event per step: arrival from source i with
+// probability lambda_i / rate, completion at device j with mu_j / rate (a no-op
+// if j is idle). Starting from step -T, two monotone bounding chains track the
+// range [lower, upper] of the number in system over all initial states; once
+// few enough states fit the range they are enumerated and moved exactly, and
+// the sample is exact when a single state is left at step 0
+class PerfectSampler {
+private:
+    static const size_t MAX_TRACKED_STATES = 1 << 16;
+    static const long long MAX_STEPS = 1ll << 26;
+
+    int num_sources;
+    int num_devices;
+    int buffer_size;
+    vector<double> cumulative_rates; // sources, then devices
+
+    // State code: busy mask | last used device | serving source + 1 | buffer counts
+    int device_bits;
+    int source_bits;
+    int count_bits;
+    bool encodable;
+
+    struct DecodedState {
+        uint64_t busy;
+        int last_used;
+        int serving_source;
+        vector<int> counts;
+    };
+    DecodedState scratch;
+
+    static int bitsFor(int values) {
+        int bits = 0;
+        while ((1 << bits) < values) bits++;
+        return bits;
+    }
+
+    uint64_t encode(const DecodedState& state) const {
+        uint64_t code = 0;
+        for (int i = num_sources - 1; i >= 0; i--) code = (code << count_bits) | (uint64_t)state.counts[i];
+        code = (code << source_bits) | (uint64_t)(state.serving_source + 1);
+        code = (code << device_bits) | (uint64_t)state.last_used;
+        return (code << num_devices) | state.busy;
+    }
+
+    void decode(uint64_t code, DecodedState& state) const {
+        state.busy = code & ((1ull << num_devices) - 1);
+        code >>= num_devices;
+        state.last_used = (int)(code & ((1ull << device_bits) - 1));
+        code >>= device_bits;
+        state.serving_source = (int)(code & ((1ull << source_bits) - 1)) - 1;
+        code >>= source_bits;
+        for (int i = 0; i < num_sources; i++) {
+            state.counts[i] = (int)(code & ((1ull << count_bits) - 1));
+            code >>= count_bits;
+        }
+    }
+
+    // Round-robin choice of SimulationModel's DeviceSelector; -1 if all busy
+    int takeFreeDevice(DecodedState& state) const {
+        for (int i = 0; i < num_devices; i++) {
+            int idx = (state.last_used + 1 + i) % num_devices;
+            if (!(state.busy & (1ull << idx))) {
+                state.busy |= 1ull << idx;
+                state.last_used = idx;
+                return idx;
+            }
+        }
+        return -1;
+    }
+
+    // One event of SimulationModel applied to the aggregated state
+    uint64_t apply(uint64_t code, int event) {
+        DecodedState& state = scratch;
+        decode(code, state);
+        int queued = 0;
+        for (int count : state.counts) queued += count;
+
+        if (event < num_sources) {
+            if (takeFreeDevice(state) >= 0) return encode(state);
+            if (queued >= buffer_size) {
+                // Rejection of the request from the highest-numbered source
+                int worst = num_sources - 1;
+                while (state.counts[worst] == 0) worst--;
+                state.counts[worst]--;
+            }
+            state.counts[event]++;
+            return encode(state);
+        }
+
+        int device_id = event - num_sources;
+        if (!(state.busy & (1ull << device_id))) return code;
+        state.busy &= ~(1ull << device_id);
+        if (queued == 0) return encode(state);
+
+        // Packet service: stay with the current source while it has requests
+        if (state.serving_source == -1 || state.counts[state.serving_source] == 0) {
+            state.serving_source = 0;
+            while (state.counts[state.serving_source] == 0) state.serving_source++;
+        }
+        state.counts[state.serving_source]--;
+        takeFreeDevice(state);
+        return encode(state);
+    }
+
+    int pickEvent(double u) const {
+        double x = u * cumulative_rates.back();
+        int event = (int)(upper_bound(cumulative_rates.begin(), cumulative_rates.end(), x) -
+            cumulative_rates.begin());
+        return min(event, (int)cumulative_rates.size() - 1);
+    }
+
+    static double binomial(int n, int k) {
+        if (k < 0 || k > n) return 0;
+        double result = 1;
+        for (int i = 1; i <= k; i++) result = result * (n - k + i) / i;
+        return result;
+    }
+
+    // Number of codes with lower <= number in system <= upper (a buffered
+    // request implies that every device is busy)
+    double countStates(int lower, int upper) const {
+        double total = 0;
+        for (int n = lower; n <= upper; n++) {
+            total += n <= num_devices ? binomial(num_devices, n) :
+                binomial(n - num_devices + num_sources - 1, num_sources - 1);
+        }
+        return total * num_devices * (num_sources + 1);
+    }
+
+    // Every round-robin pointer and serving source for the given busy mask and counts
+    void addPointerVariants(DecodedState& state, vector<uint64_t>& codes) const {
+        for (int last = 0; last < num_devices; last++) {
+            for (int serving = -1; serving < num_sources; serving++) {
+                state.last_used = last;
+                state.serving_source = serving;
+                codes.push_back(encode(state));
+            }
+        }
+    }
+
+    void enumerateCounts(DecodedState& state, int source_id, int remaining, vector<uint64_t>& codes) const {
+        if (source_id == num_sources - 1) {
+            state.counts[source_id] = remaining;
+            addPointerVariants(state, codes);
+            return;
+        }
+        for (int k = 0; k <= remaining; k++) {
+            state.counts[source_id] = k;
+            enumerateCounts(state, source_id + 1, remaining - k, codes);
+        }
+    }
+
+    vector<uint64_t> enumerateStates(int lower, int upper) const {
+        vector<uint64_t> codes;
+        DecodedState state = scratch;
+        for (int n = lower; n <= upper; n++) {
+            if (n <= num_devices) {
+                fill(state.counts.begin(), state.counts.end(), 0);
+                for (uint64_t busy = 0; busy < (1ull << num_devices); busy++) {
+                    int popcount = 0;
+                    for (int i = 0; i < num_devices; i++) popcount += (int)((busy >> i) & 1);
+                    if (popcount != n) continue;
+                    state.busy = busy;
+                    addPointerVariants(state, codes);
+                }
+            }
+            else {
+                state.busy = (1ull << num_devices) - 1;
+                enumerateCounts(state, 0, n - num_devices, codes);
+            }
+        }
+        return codes;
+    }
+
+    // Runs steps -T..-1 with draws[k] driving step -(k + 1); true if coalesced
+    bool coalesces(const vector<double>& draws, long long steps, uint64_t& result) {
+        int capacity = num_devices + buffer_size;
+        int lower = 0, upper = capacity;
+        vector<uint64_t> states;
+        bool tracking = false;
+
+        for (long long k = steps - 1; k >= 0; k--) {
+            if (!tracking && countStates(lower, upper) <= MAX_TRACKED_STATES) {
+                states = enumerateStates(lower, upper);
+                tracking = true;
+            }
+
+            int event = pickEvent(draws[k]);
+            if (tracking) {
+                for (uint64_t& code : states) code = apply(code, event);
+                sort(states.begin(), states.end());
+                states.erase(unique(states.begin(), states.end()), states.end());
+            }
+            else if (event < num_sources) {
+                lower = min(lower + 1, capacity);
+                upper = min(upper + 1, capacity);
+            }
+            else {
+                // A completion surely happens only when the buffer is non-empty
+                lower = max(lower - 1, 0);
+                if (upper > num_devices) upper--;
+            }
+        }
+
+        if (tracking && states.size() == 1) {
+            result = states[0];
+            return true;
+        }
+        return false;
+    }
+
+public:
+    PerfectSampler(const ModelConfig& config)
+        : num_sources(config.getNumSources()), num_devices(config.getNumDevices()),
+        buffer_size(config.buffer_size) {
+        double total = 0;
+        for (int i = 0; i < num_sources; i++) {
+            total += 2.0 / (config.source_min_intervals[i] + config.source_max_intervals[i]);
+            cumulative_rates.push_back(total);
+        }
+        for (int i = 0; i < num_devices; i++) {
+            total += 1.0 / config.device_mean_times[i];
+            cumulative_rates.push_back(total);
+        }
+
+        device_bits = bitsFor(num_devices);
+        source_bits = bitsFor(num_sources + 1);
+        count_bits = bitsFor(buffer_size + 1);
+        encodable = buffer_size >= 1 && num_devices <= 16 &&
+            num_devices + device_bits + source_bits + num_sources * count_bits <= 64;
+        scratch.counts.resize(num_sources);
+    }
+
+    // false - the state does not fit the 64-bit code
+    bool isSupported() const { return encodable; }
+
+    // Exact draw from the stationary distribution. Runs further into the past
+    // (doubling T) until coalescence; the draws of recent steps are kept
+    template <typename Engine>
+    bool sample(Engine& gen, SystemState& state, long long& steps) {
+        if (!encodable) return false;
+        vector<double> draws;
+        for (steps = 64; steps <= MAX_STEPS; steps *= 2) {
+            while ((long long)draws.size() < steps) draws.push_back(uniformDouble(gen));
+
+            uint64_t code;
+            if (coalesces(draws, steps, code)) {
+                DecodedState decoded = scratch;
+                decode(code, decoded);
+                state.buffer_counts = decoded.counts;
+                state.device_busy.assign(num_devices, false);
+                for (int i = 0; i < num_devices; i++) state.device_busy[i] = ((decoded.busy >> i) & 1) != 0;
+                state.last_used_device = decoded.last_used;
+                state.current_serving_source = decoded.serving_source;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Incremental re-simulation with common random numbers: the base configuration
+// runs once with a trajectory log; a changed configuration follows the same
+// trajectory up to the first event the change affects, so it restarts from the
+// last checkpoint before that event instead of from time 0
+template <typename Engine>
+class IncrementalSimulator {
+private:
+    ModelConfig base_config;
+    double max_time;
+    int max_requests;
+    Trajectory<Engine> trajectory;
+    long long base_events;
+
+public:
+    static const long long NO_DIVERGENCE = LLONG_MAX;
+
+    IncrementalSimulator(const ModelConfig& config, double time_limit, int request_limit,
+        long long checkpoint_interval = 1024)
+        : base_config(config), max_time(time_limit), max_requests(request_limit),
+        trajectory(config.buffer_size, config.getNumDevices(), checkpoint_interval) {
+        base_config.prefetch = false; // checkpoints need the streams at the event being processed
+        BasicSimulationModel<Engine> model(base_config);
+        model.recordTrajectory(&trajectory);
+        base_events = model.simulate(max_time, max_requests);
+    }
+
+    long long getBaseEvents() const { return base_events; }
+    size_t getCheckpointCount() const { return trajectory.checkpoints.size(); }
+
+    // First event index at which the changed configuration can behave differently;
+    // -1 - already the initial state differs (sources, structure, random streams)
+    long long findDivergence(const ModelConfig& changed) const {
+        const ModelConfig& base = base_config;
+        if (changed.getNumSources() != base.getNumSources() ||
+            changed.getNumDevices() != base.getNumDevices() ||
+            changed.source_min_intervals != base.source_min_intervals ||
+            changed.source_max_intervals != base.source_max_intervals ||
+            changed.seed != base.seed || changed.replication != base.replication ||
+            changed.engine != base.engine || changed.sampler != base.sampler ||
+            changed.arrivals != base.arrivals) {
+            return -1;
+        }
+
+        long long divergence = NO_DIVERGENCE;
+        // Buffer size: the first arrival to an all-busy system whose full/not
+        // full test differs, i.e. that saw at least min(old, new) requests buffered
+        if (changed.buffer_size != base.buffer_size) {
+            int threshold = min(changed.buffer_size, base.buffer_size);
+            for (int occupancy = threshold; occupancy <= base.buffer_size; occupancy++) {
+                long long event = trajectory.first_busy_arrival[occupancy];
+                if (event != -1) divergence = min(divergence, event);
+            }
+        }
+        // Device mean time: the first service time drawn at that device
+        for (int i = 0; i < base.getNumDevices(); i++) {
+            long long event = trajectory.first_service_start[i];
+            if (changed.device_mean_times[i] != base.device_mean_times[i] && event != -1) {
+                divergence = min(divergence, event);
+            }
+        }
+        return divergence;
+    }
+
+    // Run the changed configuration to the base run's limits inside model, which
+    // must be constructed from changed; returns the index of the event it resumed at
+    long long resimulate(const ModelConfig& changed, BasicSimulationModel<Engine>& model) const {
+        long long divergence = findDivergence(changed);
+        const ModelSnapshot<Engine>* checkpoint = nullptr;
+        if (divergence >= 0) {
+            for (const auto& snapshot : trajectory.checkpoints) {
+                if (snapshot.event_count > divergence) break;
+                checkpoint = &snapshot;
+            }
+        }
+        if (checkpoint) model.restoreSnapshot(*checkpoint);
+        model.simulate(max_time, max_requests);
+        return checkpoint ? checkpoint->event_count : 0;
+    }
+};
+
+// Incremental re-simulation mode (--resimulate buffer=N / deviceJ=T): checks
+// the result against a full re-run of the changed configuration
+template <typename Engine>
+void compareIncremental(ModelConfig config, const ModelConfig& changes_from, double max_time) {
+    ModelConfig changed = changes_from;
+    config.seed = changed.seed = config.resolveSeed();
+    config.prefetch = changed.prefetch = false;
+
+    cout << "=== INCREMENTAL RE-SIMULATION (model time " << max_time << ", seed " << config.seed << ") ===" << endl;
+    auto t0 = chrono::steady_clock::now();
+    IncrementalSimulator<Engine> simulator(config, max_time, INT_MAX);
+    auto t1 = chrono::steady_clock::now();
+    cout << "Base run: " << simulator.getBaseEvents() << " events, "
+        << simulator.getCheckpointCount() << " checkpoints, "
+        << fixed << setprecision(4) << chrono::duration<double>(t1 - t0).count() << " s" << endl;
+
+    if (changed.buffer_size != config.buffer_size) {
+        cout << "Change: buffer " << config.buffer_size << " -> " << changed.buffer_size << endl;
+    }
+    for (int i = 0; i < config.getNumDevices(); i++) {
+        if (changed.device_mean_times[i] != config.device_mean_times[i]) {
+            cout << "Change: D" << i + 1 << " mean time " << config.device_mean_times[i]
+                << " -> " << changed.device_mean_times[i] << endl;
+        }
+    }
+
+    long long divergence = simulator.findDivergence(changed);
+    BasicSimulationModel<Engine> incremental(changed);
+    auto t2 = chrono::steady_clock::now();
+    long long resumed_at = simulator.resimulate(changed, incremental);
+    auto t3 = chrono::steady_clock::now();
+
+    BasicSimulationModel<Engine> full(changed);
+    auto t4 = chrono::steady_clock::now();
+    full.simulate(max_time, INT_MAX);
+    auto t5 = chrono::steady_clock::now();
+
+    if (divergence == IncrementalSimulator<Engine>::NO_DIVERGENCE) {
+        cout << "Divergence: none within the base run" << endl;
+    }
+    else {
+        cout << "Divergence at event " << divergence << endl;
+    }
+    cout << "Resumed at event " << resumed_at << ": simulated "
+        << incremental.getEventCount() - resumed_at << " events in "
+        << fixed << setprecision(4) << chrono::duration<double>(t3 - t2).count() << " s, full re-run "
+        << full.getEventCount() << " events in " << chrono::duration<double>(t5 - t4).count() << " s" << endl;
+
+    bool identical = incremental.getStatistics() == full.getStatistics() &&
+        incremental.getCurrentTime() == full.getCurrentTime();
+    cout << "Result identical to the full re-run: " << (identical ? "yes" : "NO") << endl;
+    incremental.printResults();
+}
+
+// Per-source estimates of one replication
+struct ReplicationResult {
+    vector<double> reject_prob;
+    vector<double> waiting_time;
+    double setup_seconds;   // perfect sampling or warm-up
+    double run_seconds;
+    long long cftp_steps;
+    bool ok;
+    SimulationStatistics stats; // for pooling occupancy distributions
+    double end_time;
+};
+
+// Mean and 95% half-width over replications
+void printReplicationSummary(const string& mode, const vector<ReplicationResult>& results,
+    double wall_seconds) {
+    int num_sources = (int)results[0].reject_prob.size();
+    double n = (double)results.size();
+    double setup = 0, run = 0;
+    for (const auto& r : results) {
+        setup += r.setup_seconds;
+        run += r.run_seconds;
+    }
+
+    cout << setw(10) << mode << setw(12) << fixed << setprecision(4) << wall_seconds
+        << setw(14) << fixed << setprecision(6) << setup / n
+        << setw(14) << fixed << setprecision(6) << run / n;
+    for (int i = 0; i < num_sources; i++) {
+        double sum = 0, sq_sum = 0;
+        for (const auto& r : results) {
+            sum += r.reject_prob[i];
+            sq_sum += r.reject_prob[i] * r.reject_prob[i];
+        }
+        double mean = sum / n;
+        double half_width = n > 1 ? 1.96 * sqrt(max(0.0, (sq_sum - n * mean * mean) / (n - 1)) / n) : 0;
+        cout << setw(10) << fixed << setprecision(4) << mean << " +-" << setw(7) << fixed
+            << setprecision(4) << half_width;
+    }
+    cout << endl;
+}
+
+// Perfect-sampling mode (--cftp): replications started from exact stationary
+// states against replications that discard a warm-up period, run in parallel
+void comparePerfectSampling(ModelConfig config, int replications, double warmup, double horizon) {
+    config.arrivals = ARRIVALS_EXPONENTIAL;
+    config.seed = config.resolveSeed();
+    int num_sources = config.getNumSources();
+    int num_devices = config.getNumDevices();
+
+    PerfectSampler probe(config);
+    if (!probe.isSupported()) {
+        cout << "Perfect sampling: state of this configuration does not fit the 64-bit code" << endl;
+        return;
+    }
+
+    cout << "=== PERFECT SAMPLING (CFTP) VS WARM-UP ===" << endl;
+    cout << "Exponential variant, " << replications << " replications, horizon " << horizon
+        << ", warm-up " << warmup << ", seed " << config.seed << endl;
+
+    // One model per worker, reset between its replications
+    vector<unique_ptr<BasicSimulationModel<Xoshiro256PlusPlus>>> models(parallelWorkers(replications));
+
+    for (int perfect = 1; perfect >= 0; perfect--) {
+        vector<ReplicationResult> results(replications);
+        auto start = chrono::steady_clock::now();
+
+        runParallelWorkers(replications, [&](int worker, int r) {
+            ModelConfig rep_config = config;
+            rep_config.replication = r;
+            ReplicationResult& result = results[r];
+            result.cftp_steps = 0;
+            result.ok = true;
+
+            ScopedTrace replication_trace(perfect ? "CFTP replication" : "warm-up replication", r);
+            auto t0 = chrono::steady_clock::now();
+            ScopedTrace construction_trace(models[worker] ? "reset" : "construction");
+            if (models[worker]) {
+                models[worker]->reset(rep_config.seed, r);
+            }
+            else {
+                models[worker].reset(new BasicSimulationModel<Xoshiro256PlusPlus>(rep_config));
+            }
+            BasicSimulationModel<Xoshiro256PlusPlus>& model = *models[worker];
+            construction_trace.finish();
+            ScopedTrace setup_trace(perfect ? "perfect sampling" : "warm-up");
+            if (perfect) {
+                // The sampler's stream follows the stream of the last device
+                PerfectSampler sampler(rep_config);
+                Xoshiro256PlusPlus gen = StreamFactory<Xoshiro256PlusPlus>::make(config.seed, r,
+                    num_sources + num_devices);
+                SystemState state;
+                result.ok = sampler.sample(gen, state, result.cftp_steps);
+                if (result.ok) model.loadState(state);
+            }
+            else {
+                model.simulate(warmup, INT_MAX);
+                model.resetStatistics();
+            }
+            setup_trace.finish();
+            auto t1 = chrono::steady_clock::now();
+            double start_time = model.getCurrentTime();
+            ScopedTrace loop_trace("main loop");
+            model.simulate(start_time + horizon, INT_MAX);
+            loop_trace.finish();
+            auto t2 = chrono::steady_clock::now();
+            ScopedTrace reporting_trace("reporting");
+
+            result.setup_seconds = chrono::duration<double>(t1 - t0).count();
+            result.run_seconds = chrono::duration<double>(t2 - t1).count();
+            for (int i = 0; i < num_sources; i++) {
+                result.reject_prob.push_back(model.getStatistics().getRejectProbability(i));
+                result.waiting_time.push_back(model.getStatistics().getAverageWaitingTime(i));
+            }
+            result.stats = model.getStatistics();
+            result.end_time = model.getCurrentTime();
+        });
+
+        double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (perfect) {
+            long long total_steps = 0;
+            int failures = 0;
+            for (const auto& r : results) {
+                total_steps += r.cftp_steps;
+                failures += r.ok ? 0 : 1;
+            }
+            cout << "CFTP: mean backward steps " << total_steps / replications
+                << ", not coalesced " << failures << endl;
+            cout << setw(10) << "Mode" << setw(12) << "Wall, s" << setw(14) << "Setup, s"
+                << setw(14) << "Run, s";
+            for (int i = 0; i < num_sources; i++) cout << setw(19) << "P_reject S" + to_string(i + 1);
+            cout << endl;
+        }
+        printReplicationSummary(perfect ? "CFTP" : "Warm-up", results, wall);
+
+        SimulationStatistics pooled(num_sources, num_devices);
+        for (const auto& r : results) pooled.mergeOccupancy(r.stats, r.end_time);
+        cout << setw(10) << "" << " requests in system (pooled): mean = " << fixed << setprecision(3)
+            << pooled.system_occupancy.getMean(0) << ", p99 = "
+            << pooled.system_occupancy.getQuantile(0.99, 0) << endl;
+    }
+}
+
+// Sweep objective (minimized): device count (cost), buffer size, or a
+// per-source estimate of one replication
+struct Objective {
+    enum Kind { DEVICES, BUFFER, REJECT, WAIT, TOTAL };
+    Kind kind;
+    int source_id;
+
+    bool isStochastic() const { return kind != DEVICES && kind != BUFFER; }
+
+    string getName() const {
+        string source = "S" + to_string(source_id + 1);
+        switch (kind) {
+        case DEVICES: return "Devices";
+        case BUFFER: return "Buffer";
+        case REJECT: return "P_rej " + source;
+        case WAIT: return "T_wait " + source;
+        default: return "T_tot " + source;
+        }
+    }
+
+    double getValue(const ModelConfig& config, const SimulationStatistics& stats) const {
+        switch (kind) {
+        case DEVICES: return config.getNumDevices();
+        case BUFFER: return config.buffer_size;
+        case REJECT: return stats.getRejectProbability(source_id);
+        case WAIT: return stats.getAverageWaitingTime(source_id);
+        default: return stats.getAverageTotalTime(source_id);
+        }
+    }
+};
+
+// "devices,reject1,wait3" -> objectives; false on an unknown name or source
+bool parseObjectives(const string& spec, int num_sources, vector<Objective>& objectives) {
+    objectives.clear();
+    stringstream stream(spec);
+    string name;
+    while (getline(stream, name, ',')) {
+        Objective objective = { Objective::DEVICES, 0 };
+        string prefix = name.substr(0, name.find_first_of("0123456789"));
+        if (prefix == "devices" || prefix == "buffer") {
+            objective.kind = prefix == "devices" ? Objective::DEVICES : Objective::BUFFER;
+        }
+        else if (prefix == "reject" || prefix == "wait" || prefix == "total") {
+            objective.kind = prefix == "reject" ? Objective::REJECT :
+                prefix == "wait" ? Objective::WAIT : Objective::TOTAL;
+            string number = name.substr(prefix.size());
+            if (number.empty() || number.size() > 9 || number.find_first_not_of("0123456789") != string::npos) {
+                return false;
+            }
+            objective.source_id = stoi(number) - 1;
+            if (objective.source_id < 0 || objective.source_id >= num_sources) return false;
+        }
+        else {
+            return false;
+        }
+        objectives.push_back(objective);
+    }
+    return !objectives.empty();
+}
+
+// One evaluated configuration: objective values of every replication run so far
+struct SweepPoint {
+    ModelConfig config;
+    vector<vector<double>> values; // [objective][replication]
+
+    int getReplications() const { return values.empty() ? 0 : (int)values[0].size(); }
+
+    double getMean(int k) const {
+        double sum = 0;
+        for (double x : values[k]) sum += x;
+        return sum / values[k].size();
+    }
+
+    // 95% half-width of the mean
+    double getHalfWidth(int k) const {
+        double n = (double)values[k].size();
+        if (n < 2) return 0;
+        double mean = getMean(k);
+        double sq_sum = 0;
+        for (double x : values[k]) sq_sum += (x - mean) * (x - mean);
+        return 1.96 * sqrt(sq_sum / (n - 1) / n);
+    }
+
+    // Dominance of the means (no worse in every objective, better in one)
+    bool dominates(const SweepPoint& other) const {
+        bool better = false;
+        for (size_t k = 0; k < values.size(); k++) {
+            if (getMean(k) > other.getMean(k)) return false;
+            if (getMean(k) < other.getMean(k)) better = true;
+        }
+        return better;
+    }
+
+    // Dominance that holds over both confidence intervals
+    bool surelyDominates(const SweepPoint& other) const {
+        bool better = false;
+        for (size_t k = 0; k < values.size(); k++) {
+            double upper = getMean(k) + getHalfWidth(k);
+            double other_lower = other.getMean(k) - other.getHalfWidth(k);
+            if (upper > other_lower) return false;
+            if (upper < other_lower) better = true;
+        }
+        return better;
+    }
+};
+
+// Interleaved engine: one thread advances independent models round-robin,
+// events_per_turn events at a time. Before a model's turn the next model's
+// calendar top and buffer head are prefetched, so their cache misses overlap
+// with the current model's work. Every model ends exactly where its own
+// simulate(max_time, max_requests) would
+template <typename Engine>
+long long simulateInterleaved(const vector<BasicSimulationModel<Engine>*>& models,
+    double max_time, int max_requests, int events_per_turn) {
+    vector<BasicSimulationModel<Engine>*> active(models);
+    long long events = 0;
+    size_t i = 0;
+    while (!active.empty()) {
+        if (i >= active.size()) i = 0;
+        PREFETCH(active[(i + 2) % active.size()]);
+        active[(i + 1) % active.size()]->prefetch();
+        long long done = active[i]->simulate(max_time, max_requests, events_per_turn);
+        events += done;
+        if (done < events_per_turn) {
+            active[i] = active.back();
+            active.pop_back();
+        }
+        else {
+            i++;
+        }
+    }
+    return events;
+}
+
+// Runtime code generation (--codegen): a C++ source specialized to one model
+// configuration (sources and devices unrolled into switches, parameters as
+// exact constants, FIFO buffer, packet service, round-robin devices inlined)
+// is compiled by the system compiler into a shared object and loaded with
+// dlopen. Objects are cached by the hash of their source, so a configuration
+// is compiled once. The specialized loop reproduces BasicSimulationModel
+// exactly (same streams, same variates, same calendar order); it needs
+// xoshiro256++ per-entity streams and the <random> samplers
+
+// Results of the specialized loop, in the order the generated function writes them
+struct SpecializedResults {
+    double end_time;
+    int requests_served;
+    vector<int> source_requests;
+    vector<int> source_rejections;
+    vector<double> source_total_time;
+    vector<double> source_waiting_time;
+    vector<double> device_busy_time;
+
+    bool operator==(const SpecializedResults& other) const {
+        return end_time == other.end_time && requests_served == other.requests_served &&
+            source_requests == other.source_requests && source_rejections == other.source_rejections &&
+            source_total_time == other.source_total_time &&
+            source_waiting_time == other.source_waiting_time &&
+            device_busy_time == other.device_busy_time;
+    }
+};
+
+// The same numbers from a generic model
+template <typename Engine>
+SpecializedResults resultsOf(const BasicSimulationModel<Engine>& model) {
+    const SimulationStatistics& stats = model.getStatistics();
+    return SpecializedResults{ model.getCurrentTime(), stats.requests_served, stats.source_requests,
+        stats.source_rejections, stats.source_total_time, stats.source_waiting_time,
+        stats.device_busy_time };
+}
+
+// C++ source of the loop specialized to config; exported function:
+// long long simulateSpecialized(const uint64_t* stream_states, double max_time,
+//     int max_requests, double* results)
+string generateSpecializedSource(const ModelConfig& config) {
+    int num_sources = config.getNumSources();
+    int num_devices = config.getNumDevices();
+    ostringstream code;
+    code << hexfloat;
+
+    code << "// Specialized model: " << num_sources << " sources, " << num_devices
+        << " devices, buffer " << config.buffer_size << "\n"
+        << "#include <cstdint>\n#include <queue>\n#include <random>\n#include <vector>\n\n"
+        << "namespace {\n"
+        << "const int NUM_SOURCES = " << num_sources << ";\n"
+        << "const int NUM_DEVICES = " << num_devices << ";\n"
+        << "const int BUFFER_SIZE = " << config.buffer_size << ";\n"
+        << "const int RING = BUFFER_SIZE + 1;\n"
+        << "const int POOL = NUM_DEVICES + BUFFER_SIZE + 1;\n\n"
+        << "struct Xoshiro {\n"
+        << "    typedef uint64_t result_type;\n"
+        << "    uint64_t s[4];\n"
+        << "    static constexpr result_type min() { return 0; }\n"
+        << "    static constexpr result_type max() { return UINT64_MAX; }\n"
+        << "    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }\n"
+        << "    result_type operator()() {\n"
+        << "        const uint64_t result = rotl(s[0] + s[3], 23) + s[0];\n"
+        << "        const uint64_t t = s[1] << 17;\n"
+        << "        s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];\n"
+        << "        s[2] ^= t; s[3] = rotl(s[3], 45);\n"
+        << "        return result;\n"
+        << "    }\n"
+        << "};\n\n"
+        << "struct Event {\n"
+        << "    double time;\n"
+        << "    int entity;\n"
+        << "    int request; // -1 - arrival\n"
+        << "    bool operator>(const Event& other) const { return time > other.time; }\n"
+        << "};\n"
+        << "}\n\n"
+        << "extern \"C\" long long simulateSpecialized(const uint64_t* stream_states, double max_time,\n"
+        << "    int max_requests, double* results) {\n"
+        << "    Xoshiro streams[NUM_SOURCES + NUM_DEVICES];\n"
+        << "    for (int i = 0; i < NUM_SOURCES + NUM_DEVICES; i++)\n"
+        << "        for (int j = 0; j < 4; j++) streams[i].s[j] = stream_states[4 * i + j];\n\n";
+
+    for (int i = 0; i < num_sources; i++) {
+        double min_interval = config.source_min_intervals[i];
+        double max_interval = config.source_max_intervals[i];
+        if (config.arrivals == ARRIVALS_EXPONENTIAL) {
+            code << "    std::exponential_distribution<double> source" << i << "(" 
+                << 2.0 / (min_interval + max_interval) << ");\n";
+        }
+        else {
+            code << "    std::uniform_real_distribution<double> source" << i << "("
+                << min_interval << ", " << max_interval << ");\n";
+        }
+    }
+    for (int i = 0; i < num_devices; i++) {
+        code << "    std::exponential_distribution<double> device" << i << "("
+            << 1.0 / config.device_mean_times[i] << ");\n";
+    }
+
+    code << "\n    std::vector<Event> calendar_storage;\n"
+        << "    calendar_storage.reserve(NUM_SOURCES + NUM_DEVICES);\n"
+        << "    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> calendar(\n"
+        << "        std::greater<Event>(), std::move(calendar_storage));\n"
+        << "    int request_source[POOL];\n"
+        << "    double request_arrival[POOL], request_start[POOL];\n"
+        << "    int free_requests[POOL];\n"
+        << "    int free_count = POOL;\n"
+        << "    for (int i = 0; i < POOL; i++) free_requests[i] = POOL - 1 - i;\n"
+        << "    int device_request[NUM_DEVICES];\n"
+        << "    for (int i = 0; i < NUM_DEVICES; i++) device_request[i] = -1;\n"
+        << "    int ring[RING];\n"
+        << "    int head = 0, count = 0;\n"
+        << "    int last_used = -1, serving_source = -1;\n"
+        << "    int source_requests[NUM_SOURCES] = {}, source_rejections[NUM_SOURCES] = {};\n"
+        << "    double source_total[NUM_SOURCES] = {}, source_waiting[NUM_SOURCES] = {};\n"
+        << "    double device_busy[NUM_DEVICES] = {};\n"
+        << "    int served = 0;\n"
+        << "    double now = 0;\n"
+        << "    long long events = 0;\n\n"
+        << "    auto nextInterval = [&](int source) -> double {\n"
+        << "        switch (source) {\n";
+    for (int i = 0; i < num_sources; i++) {
+        code << "        case " << i << ": return source" << i << "(streams[" << i << "]);\n";
+    }
+    code << "        }\n"
+        << "        return 0;\n"
+        << "    };\n"
+        << "    auto serviceTime = [&](int device) -> double {\n"
+        << "        switch (device) {\n";
+    for (int i = 0; i < num_devices; i++) {
+        code << "        case " << i << ": return device" << i << "(streams[" << num_sources + i << "]);\n";
+    }
+    code << "        }\n"
+        << "        return 0;\n"
+        << "    };\n"
+        << "    auto freeDevice = [&]() -> int {\n"
+        << "        int start = (last_used + 1) % NUM_DEVICES;\n"
+        << "        for (int i = 0; i < NUM_DEVICES; i++) {\n"
+        << "            int idx = (start + i) % NUM_DEVICES;\n"
+        << "            if (device_request[idx] < 0) { last_used = idx; return idx; }\n"
+        << "        }\n"
+        << "        return -1;\n"
+        << "    };\n"
+        << "    auto startService = [&](int device, int request) {\n"
+        << "        double service_time = serviceTime(device);\n"
+        << "        device_request[device] = request;\n"
+        << "        request_start[request] = now;\n"
+        << "        calendar.push(Event{ now + service_time, device, request });\n"
+        << "    };\n"
+        << "    auto popFront = [&]() -> int { int r = ring[head]; head = (head + 1) % RING; count--; return r; };\n"
+        << "    auto pushBack = [&](int r) { ring[(head + count) % RING] = r; count++; };\n\n"
+        << "    for (int i = 0; i < NUM_SOURCES; i++) calendar.push(Event{ nextInterval(i), i, -1 });\n\n"
+        << "    while (!calendar.empty() && now < max_time && served < max_requests) {\n"
+        << "        Event event = calendar.top();\n"
+        << "        calendar.pop();\n"
+        << "        now = event.time;\n"
+        << "        if (event.request < 0) {\n"
+        << "            int source = event.entity;\n"
+        << "            source_requests[source]++;\n"
+        << "            int request = free_requests[--free_count];\n"
+        << "            request_source[request] = source;\n"
+        << "            request_arrival[request] = now;\n"
+        << "            calendar.push(Event{ now + nextInterval(source), source, -1 });\n"
+        << "            int device = freeDevice();\n"
+        << "            if (device >= 0) {\n"
+        << "                startService(device, request);\n"
+        << "            }\n"
+        << "            else {\n"
+        << "                if (count >= BUFFER_SIZE) {\n"
+        << "                    // Reject the request of the highest-numbered source\n"
+        << "                    int worst = -1, worst_source = -1;\n"
+        << "                    for (int n = count; n > 0; n--) {\n"
+        << "                        int r = popFront();\n"
+        << "                        if (request_source[r] > worst_source) {\n"
+        << "                            if (worst >= 0) pushBack(worst);\n"
+        << "                            worst_source = request_source[r];\n"
+        << "                            worst = r;\n"
+        << "                        }\n"
+        << "                        else {\n"
+        << "                            pushBack(r);\n"
+        << "                        }\n"
+        << "                    }\n"
+        << "                    if (worst >= 0) {\n"
+        << "                        source_rejections[worst_source]++;\n"
+        << "                        free_requests[free_count++] = worst;\n"
+        << "                    }\n"
+        << "                }\n"
+        << "                pushBack(request);\n"
+        << "            }\n"
+        << "        }\n"
+        << "        else {\n"
+        << "            int device = event.entity;\n"
+        << "            int finished = device_request[device];\n"
+        << "            device_request[device] = -1;\n"
+        << "            if (finished >= 0) {\n"
+        << "                int source = request_source[finished];\n"
+        << "                served++;\n"
+        << "                source_total[source] += now - request_arrival[finished];\n"
+        << "                source_waiting[source] += request_start[finished] - request_arrival[finished];\n"
+        << "                device_busy[device] += now - request_start[finished];\n"
+        << "                free_requests[free_count++] = finished;\n"
+        << "            }\n"
+        << "            if (count > 0) {\n"
+        << "                // Packet service: the current packet's source first, else the lowest source\n"
+        << "                int next = -1;\n"
+        << "                if (serving_source != -1) {\n"
+        << "                    for (int n = count; n > 0; n--) {\n"
+        << "                        int r = popFront();\n"
+        << "                        if (request_source[r] == serving_source && next < 0) next = r;\n"
+        << "                        else pushBack(r);\n"
+        << "                    }\n"
+        << "                    if (next < 0) serving_source = -1;\n"
+        << "                }\n"
+        << "                if (next < 0 && count > 0) {\n"
+        << "                    int best_source = NUM_SOURCES;\n"
+        << "                    for (int n = count; n > 0; n--) {\n"
+        << "                        int r = popFront();\n"
+        << "                        if (request_source[r] < best_source) {\n"
+        << "                            if (next >= 0) pushBack(next);\n"
+        << "                            best_source = request_source[r];\n"
+        << "                            next = r;\n"
+        << "                        }\n"
+        << "                        else {\n"
+        << "                            pushBack(r);\n"
+        << "                        }\n"
+        << "                    }\n"
+        << "                    serving_source = best_source;\n"
+        << "                }\n"
+        << "                if (next >= 0) {\n"
+        << "                    int free_device = freeDevice();\n"
+        << "                    if (free_device >= 0) startService(free_device, next);\n"
+        << "                }\n"
+        << "            }\n"
+        << "        }\n"
+        << "        events++;\n"
+        << "    }\n\n"
+        << "    results[0] = now;\n"
+        << "    results[1] = served;\n"
+        << "    for (int i = 0; i < NUM_SOURCES; i++) {\n"
+        << "        results[2 + 4 * i] = source_requests[i];\n"
+        << "        results[3 + 4 * i] = source_rejections[i];\n"
+        << "        results[4 + 4 * i] = source_total[i];\n"
+        << "        results[5 + 4 * i] = source_waiting[i];\n"
+        << "    }\n"
+        << "    for (int i = 0; i < NUM_DEVICES; i++) results[2 + 4 * NUM_SOURCES + i] = device_busy[i];\n"
+        << "    return events;\n"
+        << "}\n";
+    return code.str();
+}
+
+// FNV-1a hash of text (names the cached shared objects)
+uint64_t fnv1aHash(const string& text) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Shared object built from generateSpecializedSource(config). When it cannot be
+// used (other engine or sampler, no compiler, not Linux) isAvailable() is false
+// and getStatus() says why; callers then run the generic SimulationModel
+class SpecializedModel {
+private:
+    typedef long long (*SimulateFunction)(const uint64_t*, double, int, double*);
+
+    void* library;
+    SimulateFunction function;
+    int num_sources;
+    int num_devices;
+    string status;
+
+#ifdef __linux__
+    // Runs $CXX (default c++, split at spaces, no shell) on the source with its
+    // output in log_path; true on exit status 0
+    static bool compile(const string& source_path, const string& object_path, const string& log_path) {
+        const char* compiler = getenv("CXX");
+        vector<string> args;
+        stringstream words(compiler && *compiler ? compiler : "c++");
+        for (string word; words >> word;) args.push_back(word);
+        for (const char* option : { "-std=c++17", "-O2", "-shared", "-fPIC", "-o" }) args.push_back(option);
+        args.push_back(object_path);
+        args.push_back(source_path);
+        vector<char*> argv;
+        for (auto& arg : args) argv.push_back(&arg[0]);
+        argv.push_back(nullptr);
+
+        int log = open(log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (log < 0) return false;
+        pid_t pid = fork();
+        if (pid == 0) {
+            dup2(log, STDOUT_FILENO);
+            dup2(log, STDERR_FILENO);
+            close(log);
+            execvp(argv[0], argv.data());
+            fprintf(stderr, "cannot run %s: %s\n", argv[0], strerror(errno));
+            _exit(127);
+        }
+        close(log);
+        int exit_status = 0;
+        if (pid < 0 || waitpid(pid, &exit_status, 0) != pid) return false;
+        return WIFEXITED(exit_status) && WEXITSTATUS(exit_status) == 0;
+    }
+#endif
+
+public:
+    SpecializedModel(const ModelConfig& config, const string& cache_dir)
+        : library(nullptr), function(nullptr),
+        num_sources(config.getNumSources()), num_devices(config.getNumDevices()) {
+        if (config.engine != ENGINE_XOSHIRO || config.sampler != SAMPLER_STD) {
+            status = "needs --engine xoshiro and --sampler std";
+            return;
+        }
+#ifdef __linux__
+        string source = generateSpecializedSource(config);
+        ostringstream name;
+        name << cache_dir << "/model_" << hex << setw(16) << setfill('0') << fnv1aHash(source);
+        string object_path = name.str() + ".so";
+
+        if (access(object_path.c_str(), R_OK) == 0) {
+            status = "cached " + object_path;
+        }
+        else {
+            if (mkdir(cache_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+                status = "cannot create cache directory " + cache_dir + ": " + strerror(errno);
+                return;
+            }
+
+            // Source, object and log are written under names of this process and the
+            // source and object renamed into place, so concurrent runs never read or
+            // load a partial file
+            string suffix = "." + to_string(getpid());
+            string source_path = name.str() + ".cpp";
+            string temporary_source = name.str() + suffix + ".cpp"; // the compiler goes by the extension
+            string temporary_object = name.str() + suffix + ".so";
+            string log_path = name.str() + suffix + ".log";
+            if (!(ofstream(temporary_source) << source)) {
+                status = "cannot write " + temporary_source;
+                return;
+            }
+            if (!compile(temporary_source, temporary_object, log_path) ||
+                rename(temporary_object.c_str(), object_path.c_str()) != 0) {
+                remove(temporary_object.c_str());
+                remove(temporary_source.c_str());
+                status = "compilation failed, compiler output in " + log_path;
+                return;
+            }
+            rename(temporary_source.c_str(), source_path.c_str());
+            remove(log_path.c_str());
+            status = "compiled " + object_path;
+        }
+
+        library = dlopen(object_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!library) {
+            status = string("dlopen failed: ") + dlerror();
+            return;
+        }
+        function = (SimulateFunction)dlsym(library, "simulateSpecialized");
+        if (!function) status = "simulateSpecialized not found in " + object_path;
+#else
+        (void)cache_dir;
+        status = "runtime code generation needs dlopen (Linux)";
+#endif
+    }
+
+    ~SpecializedModel() {
+#ifdef __linux__
+        if (library) dlclose(library);
+#endif
+    }
+
+    SpecializedModel(const SpecializedModel&) = delete;
+    SpecializedModel& operator=(const SpecializedModel&) = delete;
+
+    bool isAvailable() const { return function != nullptr; }
+    const string& getStatus() const { return status; }
+
+    // Run one replication from the start states of makeModelStreams; returns the
+    // number of processed events
+    long long simulate(const vector<Xoshiro256PlusPlus>& streams, double max_time, int max_requests,
+        SpecializedResults& results) const {
+        vector<uint64_t> states;
+        for (const auto& stream : streams) {
+            for (int j = 0; j < 4; j++) states.push_back(stream.getStateWord(j));
+        }
+        vector<double> values(2 + 4 * num_sources + num_devices);
+        long long events = function(states.data(), max_time, max_requests, values.data());
+
+        results.end_time = values[0];
+        results.requests_served = (int)values[1];
+        results.source_requests.resize(num_sources);
+        results.source_rejections.resize(num_sources);
+        results.source_total_time.resize(num_sources);
+        results.source_waiting_time.resize(num_sources);
+        for (int i = 0; i < num_sources; i++) {
+            results.source_requests[i] = (int)values[2 + 4 * i];
+            results.source_rejections[i] = (int)values[3 + 4 * i];
+            results.source_total_time[i] = values[4 + 4 * i];
+            results.source_waiting_time[i] = values[5 + 4 * i];
+        }
+        results.device_busy_time.assign(values.begin() + 2 + 4 * num_sources, values.end());
+        return events;
+    }
+};
+
+// Multi-objective sweep over device count and buffer size. Points are printed
+// as they finish with the current Pareto front; afterwards the points that no
+// other point surely dominates (the front and everything within its confidence
+// intervals) get extra replications until their intervals are tight enough
+class ParetoSweep {
+private:
+    vector<Objective> objectives;
+    vector<SweepPoint> points;
+    double warmup;
+    double horizon;
+    int next_replication; // replication numbers are never reused across rounds
+
+    // Appends replications [first, first + count) of the point, in parallel
+    void evaluate(SweepPoint& point, int first, int count) {
+        vector<vector<double>> values(count, vector<double>(objectives.size()));
+        // One model per worker, reset between its replications
+        vector<unique_ptr<BasicSimulationModel<Xoshiro256PlusPlus>>> models(parallelWorkers(count));
+        runParallelWorkers(count, [&](int worker, int r) {
+            ModelConfig config = point.config;
+            config.replication = first + r;
+            ScopedTrace replication_trace("replication", config.replication);
+            ScopedTrace construction_trace(models[worker] ? "reset" : "construction");
+            if (models[worker]) {
+                models[worker]->reset(config.seed, config.replication);
+            }
+            else {
+                models[worker].reset(new BasicSimulationModel<Xoshiro256PlusPlus>(config));
+            }
+            BasicSimulationModel<Xoshiro256PlusPlus>& model = *models[worker];
+            construction_trace.finish();
+            {
+                ScopedTrace trace("warm-up");
+                model.simulate(warmup, INT_MAX);
+                model.resetStatistics();
+            }
+            {
+                ScopedTrace trace("main loop");
+                model.simulate(model.getCurrentTime() + horizon, INT_MAX);
+            }
+            ScopedTrace trace("reporting");
+            for (size_t k = 0; k < objectives.size(); k++) {
+                values[r][k] = objectives[k].getValue(config, model.getStatistics());
+            }
+        });
+        point.values.resize(objectives.size());
+        for (size_t k = 0; k < objectives.size(); k++) {
+            for (int r = 0; r < count; r++) point.values[k].push_back(values[r][k]);
+        }
+    }
+
+    bool isOnFront(int index, int num_points) const {
+        for (int j = 0; j < num_points; j++) {
+            if (j != index && points[j].dominates(points[index])) return false;
+        }
+        return true;
+    }
+
+    bool isNearFront(int index) const {
+        for (int j = 0; j < (int)points.size(); j++) {
+            if (j != index && points[j].surelyDominates(points[index])) return false;
+        }
+        return true;
+    }
+
+    void printHeader() const {
+        cout << setw(8) << "Devices" << setw(8) << "Buffer" << setw(6) << "Reps";
+        for (const auto& objective : objectives) cout << setw(22) << objective.getName();
+        cout << setw(8) << "Front" << endl;
+    }
+
+    void printPoint(int index, int num_points) const {
+        const SweepPoint& point = points[index];
+        cout << setw(8) << point.config.getNumDevices() << setw(8) << point.config.buffer_size
+            << setw(6) << point.getReplications();
+        for (size_t k = 0; k < objectives.size(); k++) {
+            cout << setw(12) << fixed << setprecision(4) << point.getMean(k)
+                << " +-" << setw(7) << fixed << setprecision(4) << point.getHalfWidth(k);
+        }
+        cout << setw(8) << (isOnFront(index, num_points) ? "*" : "") << endl;
+    }
+
+public:
+    ParetoSweep(const vector<Objective>& sweep_objectives, double warmup_time, double horizon_time)
+        : objectives(sweep_objectives), warmup(warmup_time), horizon(horizon_time), next_replication(0) {
+    }
+
+    void run(const ModelConfig& base, int max_devices, int max_buffer, int replications,
+        double relative_precision, int max_rounds) {
+        cout << "=== PARETO SWEEP ===" << endl;
+        cout << "Devices 1.." << max_devices << ", buffer 1.." << max_buffer << ", "
+            << replications << " replications per point, horizon " << horizon
+            << ", warm-up " << warmup << ", seed " << base.seed << endl;
+        printHeader();
+
+        for (int devices = 1; devices <= max_devices; devices++) {
+            for (int buffer = 1; buffer <= max_buffer; buffer++) {
+                ScopedTrace trace("sweep point", (int)points.size());
+                SweepPoint point;
+                point.config = base;
+                point.config.setNumDevices(devices);
+                point.config.buffer_size = buffer;
+                points.push_back(point);
+                evaluate(points.back(), 0, replications);
+
+                // Streaming update: the new point, then the front so far
+                int num_points = (int)points.size();
+                printPoint(num_points - 1, num_points);
+                int front_size = 0;
+                for (int i = 0; i < num_points; i++) front_size += isOnFront(i, num_points) ? 1 : 0;
+                cout << "  front: " << front_size << " of " << num_points << " points" << endl;
+            }
+        }
+        next_replication = replications;
+
+        // Extra replications for points near the front whose stochastic
+        // objectives are not yet within the relative precision
+        for (int round = 1; round <= max_rounds; round++) {
+            vector<int> refine;
+            for (int i = 0; i < (int)points.size(); i++) {
+                if (!isNearFront(i)) continue;
+                bool precise = true;
+                for (size_t k = 0; k < objectives.size(); k++) {
+                    if (!objectives[k].isStochastic()) continue;
+                    double mean = fabs(points[i].getMean(k));
+                    if (points[i].getHalfWidth(k) > relative_precision * max(mean, 1e-3)) precise = false;
+                }
+                if (!precise) refine.push_back(i);
+            }
+            if (refine.empty()) break;
+
+            // Replication numbers are shared by all points (common random numbers)
+            int count = next_replication;
+            for (int i : refine) {
+                ScopedTrace trace("refine point", i);
+                evaluate(points[i], next_replication, count);
+            }
+            next_replication += count;
+            cout << "Refinement round " << round << ": " << refine.size() << " points near the front, +"
+                << count << " replications each" << endl;
+        }
+
+        cout << "\n--- PARETO FRONT ---" << endl;
+        printHeader();
+        for (int i = 0; i < (int)points.size(); i++) {
+            if (isOnFront(i, (int)points.size())) printPoint(i, (int)points.size());
+        }
+    }
+};
+
+// Design-of-experiments factor: a source's mean interarrival time (the interval
+// scaled around its mean), a device's mean service time or the buffer size,
+// varied over [low, high]
+struct DesignFactor {
+    enum Kind { SOURCE_INTERVAL, DEVICE_MEAN, BUFFER };
+    Kind kind;
+    int index;
+    double low;
+    double high;
+
+    string getName() const {
+        switch (kind) {
+        case SOURCE_INTERVAL: return "interval_S" + to_string(index + 1);
+        case DEVICE_MEAN: return "service_D" + to_string(index + 1);
+        default: return "buffer";
+        }
+    }
+
+    // Factor value at the unit coordinate u in [0, 1); the buffer size takes
+    // every integer of [low, high] with equal probability
+    double getValue(double u) const {
+        if (kind == BUFFER) return min(high, low + floor(u * (high - low + 1)));
+        return low + u * (high - low);
+    }
+
+    void apply(ModelConfig& config, const ModelConfig& base, double value) const {
+        if (kind == SOURCE_INTERVAL) {
+            double scale = value / ((base.source_min_intervals[index] + base.source_max_intervals[index]) / 2);
+            config.source_min_intervals[index] = base.source_min_intervals[index] * scale;
+            config.source_max_intervals[index] = base.source_max_intervals[index] * scale;
+        }
+        else if (kind == DEVICE_MEAN) {
+            config.device_mean_times[index] = value;
+        }
+        else {
+            config.buffer_size = (int)value;
+        }
+    }
+};
+
+// Every source interval, device mean and the buffer size, each within
+// [1 - spread, 1 + spread] times its base value (the buffer at least 1)
+vector<DesignFactor> makeDesignFactors(const ModelConfig& base, double spread) {
+    vector<DesignFactor> factors;
+    for (int i = 0; i < base.getNumSources(); i++) {
+        double mean = (base.source_min_intervals[i] + base.source_max_intervals[i]) / 2;
+        factors.push_back({ DesignFactor::SOURCE_INTERVAL, i, mean * (1 - spread), mean * (1 + spread) });
+    }
+    for (int j = 0; j < base.getNumDevices(); j++) {
+        double mean = base.device_mean_times[j];
+        factors.push_back({ DesignFactor::DEVICE_MEAN, j, mean * (1 - spread), mean * (1 + spread) });
+    }
+    factors.push_back({ DesignFactor::BUFFER, 0, max(1.0, floor(base.buffer_size * (1 - spread))),
+        max(1.0, ceil(base.buffer_size * (1 + spread))) });
+    return factors;
+}
+
+// Latin hypercube of n points in [0, 1)^d: every coordinate takes one
+// uniformly placed value in each of the n strata, strata randomly paired
+vector<vector<double>> latinHypercube(int n, int dimensions, uint64_t seed) {
+    Xoshiro256PlusPlus gen(seed);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    vector<vector<double>> points(n, vector<double>(dimensions));
+    vector<int> strata(n);
+    for (int k = 0; k < dimensions; k++) {
+        for (int i = 0; i < n; i++) strata[i] = i;
+        shuffle(strata.begin(), strata.end(), gen);
+        for (int i = 0; i < n; i++) points[i][k] = (strata[i] + uniform(gen)) / n;
+    }
+    return points;
+}
+
+// Sobol sequence (Joe & Kuo direction numbers) with hash-based Owen scrambling
+// (Laine-Karras permutation of the bit-reversed coordinate, Burley 2020): the
+// scrambled points keep the (t, m, s)-net structure of every power-of-two prefix
+class SobolSequence {
+private:
+    // Degree s, coefficients a and initial m_1..m_s of dimensions 2..MAX_DIMENSIONS
+    struct Primitive {
+        int degree;
+        unsigned coefficients;
+        unsigned initial[7];
+    };
+
+    static const int BITS = 32;
+    vector<vector<uint32_t>> directions; // [dimension][bit]
+    vector<uint32_t> seeds;
+    vector<uint32_t> state;
+    uint32_t index;
+
+    static uint32_t reverseBits(uint32_t x) {
+        x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+        x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+        x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+        x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    // Nested uniform scramble: each bit is flipped by a hash of the bits above it
+    static uint32_t scramble(uint32_t x, uint32_t seed) {
+        x = reverseBits(x);
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return reverseBits(x);
+    }
+
+public:
+    static const int MAX_DIMENSIONS = 21;
+
+    SobolSequence(int dimensions, uint64_t seed) : state(dimensions, 0), index(0) {
+        static const Primitive primitives[MAX_DIMENSIONS - 1] = {
+            { 1, 0, { 1 } }, { 2, 1, { 1, 3 } }, { 3, 1, { 1, 3, 1 } }, { 3, 2, { 1, 1, 1 } },
+            { 4, 1, { 1, 1, 3, 3 } }, { 4, 4, { 1, 3, 5, 13 } }, { 5, 2, { 1, 1, 5, 5, 17 } },
+            { 5, 4, { 1, 1, 5, 5, 5 } }, { 5, 7, { 1, 1, 7, 11, 19 } }, { 5, 11, { 1, 1, 5, 1, 1 } },
+            { 5, 13, { 1, 1, 1, 3, 11 } }, { 5, 14, { 1, 3, 5, 5, 31 } }, { 6, 1, { 1, 3, 3, 9, 7, 49 } },
+            { 6, 13, { 1, 1, 1, 15, 21, 21 } }, { 6, 16, { 1, 3, 1, 13, 27, 49 } },
+            { 6, 19, { 1, 1, 1, 15, 7, 5 } }, { 6, 22, { 1, 3, 1, 15, 13, 25 } },
+            { 6, 25, { 1, 1, 5, 5, 19, 61 } }, { 7, 1, { 1, 3, 7, 11, 23, 15, 103 } },
+            { 7, 4, { 1, 3, 7, 13, 13, 15, 69 } }
+        };
+        directions.assign(dimensions, vector<uint32_t>(BITS));
+        for (int i = 0; i < BITS; i++) directions[0][i] = 1u << (BITS - 1 - i);
+        for (int k = 1; k < dimensions; k++) {
+            const Primitive& p = primitives[k - 1];
+            int s = p.degree;
+            for (int i = 0; i < BITS; i++) {
+                if (i < s) {
+                    directions[k][i] = p.initial[i] << (BITS - 1 - i);
+                    continue;
+                }
+                uint32_t v = directions[k][i - s] ^ (directions[k][i - s] >> s);
+                for (int j = 1; j < s; j++) {
+                    if ((p.coefficients >> (s - 1 - j)) & 1) v ^= directions[k][i - j];
+                }
+                directions[k][i] = v;
+            }
+        }
+        Xoshiro256PlusPlus gen(seed);
+        for (int k = 0; k < dimensions; k++) seeds.push_back((uint32_t)gen());
+    }
+
+    // Next point in [0, 1)^d (Gray-code order, starting with the origin)
+    vector<double> next() {
+        vector<double> point(state.size());
+        for (size_t k = 0; k < state.size(); k++) {
+            point[k] = scramble(state[k], seeds[k]) * (1.0 / 4294967296.0);
+        }
+        int bit = 0;
+        for (uint32_t i = index; i & 1; i >>= 1) bit++;
+        for (size_t k = 0; k < state.size(); k++) state[k] ^= directions[k][bit];
+        index++;
+        return point;
+    }
+};
+
+// Centered L2 discrepancy of points in [0, 1)^d (Hickernell); lower is more
+// uniform, 0 for an empty design
+double centeredDiscrepancy(const vector<vector<double>>& points) {
+    if (points.empty()) return 0;
+    double n = (double)points.size();
+    int d = (int)points[0].size();
+    double first = pow(13.0 / 12, d);
+    double second = 0, third = 0;
+    for (const auto& x : points) {
+        double product = 1;
+        for (double u : x) product *= 1 + 0.5 * fabs(u - 0.5) - 0.5 * (u - 0.5) * (u - 0.5);
+        second += product;
+        for (const auto& y : points) {
+            double pair = 1;
+            for (int k = 0; k < d; k++) {
+                pair *= 1 + 0.5 * fabs(x[k] - 0.5) + 0.5 * fabs(y[k] - 0.5) - 0.5 * fabs(x[k] - y[k]);
+            }
+            third += pair;
+        }
+    }
+    return sqrt(max(0.0, first - 2 * second / n + third / (n * n)));
+}
+
+// Outputs recorded for every design run: overall and per-source rejection
+// probability, per-source waiting time and per-device utilization
+vector<string> getDesignOutputNames(const ModelConfig& config) {
+    vector<string> names = { "reject" };
+    for (int i = 0; i < config.getNumSources(); i++) names.push_back("reject_S" + to_string(i + 1));
+    for (int i = 0; i < config.getNumSources(); i++) names.push_back("wait_S" + to_string(i + 1));
+    for (int j = 0; j < config.getNumDevices(); j++) names.push_back("util_D" + to_string(j + 1));
+    return names;
+}
+
+vector<double> getDesignOutputs(const ModelConfig& config, const SimulationStatistics& stats, double time) {
+    vector<double> outputs = { stats.requests_generated > 0 ?
+        (double)stats.requests_rejected / stats.requests_generated : 0.0 };
+    for (int i = 0; i < config.getNumSources(); i++) outputs.push_back(stats.getRejectProbability(i));
+    for (int i = 0; i < config.getNumSources(); i++) outputs.push_back(stats.getAverageWaitingTime(i));
+    for (int j = 0; j < config.getNumDevices(); j++) outputs.push_back(stats.getUtilization(j, time));
+    return outputs;
+}
+
+// Outputs of one replication at the given factor values
+vector<double> runDesignPoint(const ModelConfig& base, const vector<DesignFactor>& factors,
+    const vector<double>& values, int replication, double warmup, double horizon) {
+    ModelConfig config = base;
+    config.replication = replication;
+    for (size_t k = 0; k < factors.size(); k++) factors[k].apply(config, base, values[k]);
+    BasicSimulationModel<Xoshiro256PlusPlus> model(config);
+    model.simulate(warmup, INT_MAX);
+    model.resetStatistics();
+    model.simulate(model.getCurrentTime() + horizon, INT_MAX);
+    return getDesignOutputs(config, model.getStatistics(), model.getCurrentTime());
+}
+
+// Evaluates every design point (unit coordinates mapped through the factors)
+// with the given replications, all runs in parallel. Replication r of every
+// point uses replication number r (common random numbers across the design).
+// Returns outputs[point * replications + r]
+vector<vector<double>> evaluateDesign(const ModelConfig& base, const vector<DesignFactor>& factors,
+    const vector<vector<double>>& design, int replications, double warmup, double horizon) {
+    int num_runs = (int)design.size() * replications;
+    vector<vector<double>> outputs(num_runs);
+    runParallel(num_runs, [&](int run) {
+        int point = run / replications;
+        vector<double> values;
+        for (size_t k = 0; k < factors.size(); k++) values.push_back(factors[k].getValue(design[point][k]));
+        ScopedTrace trace("design run", run);
+        outputs[run] = runDesignPoint(base, factors, values, run % replications, warmup, horizon);
+    });
+    return outputs;
+}
+
+// Design results read back for metamodel fitting: factor values and one
+// output per point, as the replication mean and the variance of that mean
+struct DesignData {
+    vector<string> factor_names;
+    vector<vector<double>> inputs; // [point][factor]
+    vector<int> point_numbers;     // point column of the CSV
+    vector<int> counts;            // replications of the point
+    vector<double> means;
+    vector<double> sq_deviations;  // sum of squared deviations from the mean
+    vector<double> mean_variances; // -1 - a single replication, no variance estimate
+    int next_point;                // point number of the next new point
+
+    DesignData() : next_point(0) {}
+
+    // Index of the point with these factor values, -1 - none
+    int findPoint(const vector<double>& input) const {
+        for (size_t i = 0; i < inputs.size(); i++) {
+            if (inputs[i] == input) return (int)i;
+        }
+        return -1;
+    }
+
+    // Runs of point `number`; runs of a point already present are merged into
+    // its mean and squared deviations (pairwise update of Chan et al.)
+    void addRuns(int number, const vector<double>& input, const vector<double>& values) {
+        double n = (double)values.size();
+        double sum = 0;
+        for (double x : values) sum += x;
+        double mean = sum / n;
+        double sq_sum = 0;
+        for (double x : values) sq_sum += (x - mean) * (x - mean);
+
+        int i = (int)(find(point_numbers.begin(), point_numbers.end(), number) - point_numbers.begin());
+        if (i == (int)point_numbers.size()) {
+            inputs.push_back(input);
+            point_numbers.push_back(number);
+            counts.push_back((int)n);
+            means.push_back(mean);
+            sq_deviations.push_back(sq_sum);
+            mean_variances.push_back(-1);
+        }
+        else {
+            double total = counts[i] + n;
+            double delta = mean - means[i];
+            sq_deviations[i] += sq_sum + delta * delta * counts[i] * n / total;
+            means[i] += delta * n / total;
+            counts[i] = (int)total;
+        }
+        mean_variances[i] = counts[i] > 1 ? sq_deviations[i] / (counts[i] - 1) / counts[i] : -1;
+        next_point = max(next_point, number + 1);
+    }
+
+    // Points without a variance estimate take the average of the others
+    double getMeanVariance(int i) const {
+        if (mean_variances[i] >= 0) return mean_variances[i];
+        double sum = 0;
+        int count = 0;
+        for (double v : mean_variances) {
+            if (v >= 0) {
+                sum += v;
+                count++;
+            }
+        }
+        return count > 0 ? sum / count : 0;
+    }
+};
+
+// Reads a --doe CSV (point, replication, factor columns, output columns);
+// false with a message on a missing file, output or malformed row
+bool readDesignCsv(const string& path, const string& output_name, DesignData& data, string& error) {
+    ifstream file(path);
+    if (!file) {
+        error = "cannot read " + path;
+        return false;
+    }
+    string line;
+    getline(file, line);
+    vector<string> header;
+    stringstream header_stream(line);
+    for (string name; getline(header_stream, name, ',');) header.push_back(name);
+    int first_output = (int)(find(header.begin(), header.end(), "reject") - header.begin());
+    int output = (int)(find(header.begin(), header.end(), output_name) - header.begin());
+    if (header.size() < 3 || header[0] != "point" || first_output == (int)header.size()) {
+        error = path + " is not a design CSV";
+        return false;
+    }
+    if (output == (int)header.size()) {
+        error = "no output " + output_name + " in " + path;
+        return false;
+    }
+    data = DesignData();
+    data.factor_names.assign(header.begin() + 2, header.begin() + first_output);
+
+    // Runs of a point are consecutive, except those a metamodel server appended
+    // to an earlier point later on; addRuns merges them either way
+    int current = -1;
+    vector<double> input, values;
+    while (getline(file, line)) {
+        if (line.empty() || line == "\r") continue;
+        vector<double> row;
+        bool valid = true;
+        stringstream row_stream(line);
+        for (string cell; valid && getline(row_stream, cell, ',');) {
+            char* end = nullptr;
+            double value = strtod(cell.c_str(), &end);
+            while (end != cell.c_str() && (*end == ' ' || *end == '\r')) end++;
+            valid = end != cell.c_str() && *end == '\0';
+            row.push_back(value);
+        }
+        if (!valid || row.size() != header.size() || row[0] < 0 || row[0] != floor(row[0])) {
+            error = "malformed row in " + path + ": " + line;
+            return false;
+        }
+        if ((int)row[0] != current) {
+            if (!values.empty()) data.addRuns(current, input, values);
+            current = (int)row[0];
+            input.assign(row.begin() + 2, row.begin() + first_output);
+            values.clear();
+        }
+        values.push_back(row[output]);
+    }
+    if (!values.empty()) data.addRuns(current, input, values);
+    if (data.means.size() < 2) {
+        error = path + " has fewer than two points";
+        return false;
+    }
+    return true;
+}
+
+// Gaussian-process metamodel: squared-exponential kernel with one length scale
+// per factor (inputs scaled to the design's range), the replication variance of
+// every point as its noise. Hyperparameters maximize the log marginal
+// likelihood by coordinate search; a refit after new points keeps them and
+// only refactorizes. A prediction costs O(n d + n^2)
+class GaussianProcess {
+private:
+    vector<double> lower;
+    vector<double> scale;
+    vector<vector<double>> x; // scaled inputs
+    vector<double> y;         // outputs minus their mean
+    vector<double> noise;
+    double y_mean;
+    vector<double> length_scales;
+    double signal_variance;
+    Matrix cholesky;          // lower factor of K + noise
+    vector<double> alpha;     // (K + noise)^-1 y
+    double log_likelihood;
+
+    vector<double> scaleInput(const vector<double>& input) const {
+        vector<double> scaled(input.size());
+        for (size_t k = 0; k < input.size(); k++) scaled[k] = (input[k] - lower[k]) / scale[k];
+        return scaled;
+    }
+
+    double kernel(const vector<double>& a, const vector<double>& b) const {
+        double distance = 0;
+        for (size_t k = 0; k < a.size(); k++) {
+            double d = (a[k] - b[k]) / length_scales[k];
+            distance += d * d;
+        }
+        return signal_variance * exp(-0.5 * distance);
+    }
+
+    // L z = b by forward substitution
+    vector<double> solveLower(const vector<double>& b) const {
+        int n = (int)b.size();
+        vector<double> z(n);
+        for (int i = 0; i < n; i++) {
+            double sum = b[i];
+            for (int j = 0; j < i; j++) sum -= cholesky(i, j) * z[j];
+            z[i] = sum / cholesky(i, i);
+        }
+        return z;
+    }
+
+    // Cholesky factor, alpha and log marginal likelihood; false if not positive definite
+    bool factorize() {
+        int n = (int)x.size();
+        cholesky = Matrix(n, n);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j <= i; j++) {
+                double sum = kernel(x[i], x[j]);
+                if (i == j) sum += noise[i] + 1e-8 * signal_variance;
+                for (int k = 0; k < j; k++) sum -= cholesky(i, k) * cholesky(j, k);
+                if (i == j) {
+                    if (sum <= 0) return false;
+                    cholesky(i, i) = sqrt(sum);
+                }
+                else {
+                    cholesky(i, j) = sum / cholesky(j, j);
+                }
+            }
+        }
+        vector<double> z = solveLower(y);
+        alpha.assign(n, 0);
+        for (int i = n - 1; i >= 0; i--) {
+            double sum = z[i];
+            for (int j = i + 1; j < n; j++) sum -= cholesky(j, i) * alpha[j];
+            alpha[i] = sum / cholesky(i, i);
+        }
+        log_likelihood = -0.5 * n * log(2 * acos(-1.0));
+        for (int i = 0; i < n; i++) log_likelihood -= 0.5 * y[i] * alpha[i] + log(cholesky(i, i));
+        return true;
+    }
+
+public:
+    GaussianProcess() : y_mean(0), signal_variance(1), log_likelihood(0) {}
+
+    // optimize - search hyperparameters and the input scaling (first fit)
+    bool fit(const DesignData& data, bool optimize) {
+        int n = (int)data.means.size();
+        int d = (int)data.factor_names.size();
+        if (optimize) {
+            lower.assign(d, 0);
+            scale.assign(d, 1);
+            for (int k = 0; k < d; k++) {
+                double low = data.inputs[0][k], high = low;
+                for (const auto& input : data.inputs) {
+                    low = min(low, input[k]);
+                    high = max(high, input[k]);
+                }
+                lower[k] = low;
+                scale[k] = high > low ? high - low : 1;
+            }
+        }
+        x.clear();
+        for (const auto& input : data.inputs) x.push_back(scaleInput(input));
+        y_mean = 0;
+        for (double m : data.means) y_mean += m / n;
+        y.clear();
+        noise.clear();
+        double variance = 0;
+        for (int i = 0; i < n; i++) {
+            y.push_back(data.means[i] - y_mean);
+            noise.push_back(data.getMeanVariance(i));
+            variance += y.back() * y.back() / n;
+        }
+        if (!optimize) return factorize();
+
+        length_scales.assign(d, 0.5);
+        signal_variance = max(variance, 1e-12);
+        if (!factorize()) return false;
+        // Coordinate search in log space, halving the step when nothing improves
+        for (double step = 2.0; step > 1.05; step = sqrt(step)) {
+            for (bool improved = true; improved;) {
+                improved = false;
+                for (int k = 0; k <= d; k++) {
+                    double& parameter = k < d ? length_scales[k] : signal_variance;
+                    for (double factor : { step, 1 / step }) {
+                        double previous = parameter, best = log_likelihood;
+                        parameter *= factor;
+                        if ((k < d && parameter > 100) || !factorize() || log_likelihood <= best + 1e-9) {
+                            parameter = previous;
+                            factorize();
+                        }
+                        else {
+                            improved = true;
+                        }
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    void predict(const vector<double>& input, double& mean, double& sd) const {
+        vector<double> scaled = scaleInput(input);
+        int n = (int)x.size();
+        vector<double> k_star(n);
+        mean = y_mean;
+        for (int i = 0; i < n; i++) {
+            k_star[i] = kernel(scaled, x[i]);
+            mean += k_star[i] * alpha[i];
+        }
+        vector<double> v = solveLower(k_star);
+        double variance = signal_variance;
+        for (double value : v) variance -= value * value;
+        sd = sqrt(max(0.0, variance));
+    }
+
+    // Leave-one-out residuals and predictive standard deviations (closed form
+    // from the diagonal of (K + noise)^-1), noise included
+    void leaveOneOut(vector<double>& residuals, vector<double>& sds) const {
+        int n = (int)x.size();
+        Matrix covariance(n, n);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                covariance(i, j) = kernel(x[i], x[j]) + (i == j ? noise[i] + 1e-8 * signal_variance : 0);
+            }
+        }
+        Matrix inverse = covariance.inverse();
+        residuals.assign(n, 0);
+        sds.assign(n, 0);
+        for (int i = 0; i < n; i++) {
+            residuals[i] = alpha[i] / inverse(i, i);
+            sds[i] = sqrt(1 / inverse(i, i));
+        }
+    }
+
+    int getPoints() const { return (int)x.size(); }
+    double getLengthScale(int k) const { return length_scales[k] * scale[k]; }
+    double getSignalSd() const { return sqrt(signal_variance); }
+    double getLogLikelihood() const { return log_likelihood; }
+};
+
+// Statistical check of one sampler: moments, Kolmogorov-Smirnov and chi-square
+// against the expected CDF (all thresholds at roughly the 0.1% level)
+bool checkSamples(const string& name, vector<double>& samples,
+    double expected_mean, double expected_variance, double (*cdf)(double)) {
+    const int num_bins = 100;
+    double n = (double)samples.size();
+
+    double sum = 0;
+    for (double x : samples) sum += x;
+    double mean = sum / n;
+    double sq_sum = 0;
+    for (double x : samples) sq_sum += (x - mean) * (x - mean);
+    double variance = sq_sum / (n - 1);
+
+    sort(samples.begin(), samples.end());
+    double ks = 0;
+    vector<int> bins(num_bins, 0);
+    for (size_t i = 0; i < samples.size(); i++) {
+        double f = cdf(samples[i]);
+        ks = max(ks, max(f - i / n, (i + 1) / n - f));
+        bins[min(num_bins - 1, (int)(f * num_bins))]++;
+    }
+    double chi2 = 0;
+    double expected_count = n / num_bins;
+    for (int count : bins) chi2 += (count - expected_count) * (count - expected_count) / expected_count;
+
+    // 5 sigma on the moments (variance of the sample variance taken as 8/n, exact for Exp(1))
+    bool mean_ok = fabs(mean - expected_mean) < 5 * sqrt(expected_variance / n);
+    bool variance_ok = fabs(variance - expected_variance) < 5 * sqrt(8.0 / n) * expected_variance;
+    bool ks_ok = ks < 1.95 / sqrt(n);
+    bool chi2_ok = chi2 < 148.2; // 99 degrees of freedom
+
+    cout << setw(38) << name
+        << setw(10) << fixed << setprecision(4) << mean
+        << setw(10) << fixed << setprecision(4) << variance
+        << setw(10) << fixed << setprecision(5) << ks
+        << setw(10) << fixed << setprecision(1) << chi2
+        << setw(8) << ((mean_ok && variance_ok && ks_ok && chi2_ok) ? "PASS" : "FAIL") << endl;
+    return mean_ok && variance_ok && ks_ok && chi2_ok;
+}
+
+// Keeps timed loops from being optimized away
+volatile double benchmark_sink;
+
+double exponentialCdf(double x) { return x > 0 ? 1 - exp(-x) : 0; }
+double uniformCdf(double x) { return min(1.0, max(0.0, x)); }
+
+template <typename Engine>
+bool verifySamplersWith(const string& engine_name, unsigned seed, int num_samples) {
+    Engine gen(seed);
+    vector<double> samples(num_samples);
+    bool ok = true;
+
+    for (double& x : samples) x = ZigguratExponential::sample(gen);
+    ok &= checkSamples("ziggurat exp, " + engine_name, samples, 1.0, 1.0, exponentialCdf);
+
+    for (double& x : samples) x = uniformDouble(gen);
+    ok &= checkSamples("uniformDouble, " + engine_name, samples, 0.5, 1.0 / 12, uniformCdf);
+
+    // Throughput against the <random> distributions on the same engine
+    exponential_distribution<double> exp_dist(1.0);
+    uniform_real_distribution<double> uni_dist(0.0, 1.0);
+    double sink = 0;
+    auto t0 = chrono::steady_clock::now();
+    for (int i = 0; i < num_samples; i++) sink += exp_dist(gen);
+    auto t1 = chrono::steady_clock::now();
+    for (int i = 0; i < num_samples; i++) sink += ZigguratExponential::sample(gen);
+    auto t2 = chrono::steady_clock::now();
+    for (int i = 0; i < num_samples; i++) sink += uni_dist(gen);
+    auto t3 = chrono::steady_clock::now();
+    for (int i = 0; i < num_samples; i++) sink += uniformDouble(gen);
+    auto t4 = chrono::steady_clock::now();
+
+    auto ns = [num_samples](chrono::steady_clock::time_point a, chrono::steady_clock::time_point b) {
+        return chrono::duration<double, nano>(b - a).count() / num_samples;
+    };
+    cout << "  ns/sample: exponential_distribution " << setprecision(2) << ns(t0, t1)
+        << ", ziggurat " << ns(t1, t2)
+        << ", uniform_real_distribution " << ns(t2, t3)
+        << ", uniformDouble " << ns(t3, t4) << endl;
+
+    benchmark_sink = sink;
+    return ok;
+}
+
+// Sampler test mode (--verify-sampler)
+bool verifySamplers(unsigned seed) {
+    const int num_samples = 1000000;
+    cout << "=== SAMPLER VERIFICATION (" << num_samples << " samples, seed " << seed << ") ===" << endl;
+    cout << setw(38) << "Sampler" << setw(10) << "Mean" << setw(10) << "Variance"
+        << setw(10) << "KS" << setw(10) << "Chi2" << setw(8) << "Result" << endl;
+
+    bool ok = verifySamplersWith<default_random_engine>("default_random_engine", seed, num_samples);
+    ok &= verifySamplersWith<mt19937_64>("mt19937_64", seed, num_samples);
+
+    cout << (ok ? "All sampler checks passed" : "Sampler checks FAILED") << endl;
+    return ok;
+}
+
+template <typename Engine>
+double engineNsPerCall(uint64_t seed, int calls) {
+    Engine gen = StreamFactory<Engine>::make(seed, 0, 0);
+    uint64_t sum = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < calls; i++) sum += (uint64_t)gen();
+    auto finish = chrono::steady_clock::now();
+    benchmark_sink = (double)sum;
+    return chrono::duration<double, nano>(finish - start).count() / calls;
+}
+
+// Events/second of SimulationModel::simulate with the given engine
+template <typename Engine>
+double modelEventsPerSecond(const ModelConfig& config, double max_time, long long& events) {
+    BasicSimulationModel<Engine> model(config);
+    auto start = chrono::steady_clock::now();
+    events = model.simulate(max_time, INT_MAX);
+    auto finish = chrono::steady_clock::now();
+    return events / chrono::duration<double>(finish - start).count();
+}
+
+template <typename Engine>
+void benchmarkEngine(ModelConfig config, double max_time) {
+    const int calls = 10000000;
+    long long events = 0;
+    config.sampler = SAMPLER_STD;
+    double std_rate = modelEventsPerSecond<Engine>(config, max_time, events);
+    config.sampler = SAMPLER_ZIGGURAT;
+    double ziggurat_rate = modelEventsPerSecond<Engine>(config, max_time, events);
+
+    cout << setw(24) << StreamFactory<Engine>::name()
+        << setw(12) << fixed << setprecision(2) << engineNsPerCall<Engine>(config.seed, calls)
+        << setw(12) << events
+        << setw(16) << fixed << setprecision(0) << std_rate
+        << setw(16) << fixed << setprecision(0) << ziggurat_rate << endl;
+}
+
+// One row of the per-operation table: body() runs the case and returns its
+// operation count
+void benchmarkCase(const string& name, bool perf, const function<long long()>& body) {
+    HardwareCounters counters;
+    if (perf) counters.start();
+    auto start = chrono::steady_clock::now();
+    long long operations = body();
+    auto finish = chrono::steady_clock::now();
+    CounterValues values = perf ? counters.stop() : CounterValues{ 0, 0, 0, 0 };
+
+    cout << setw(32) << name << setw(12) << operations << setw(10) << fixed << setprecision(2)
+        << chrono::duration<double, nano>(finish - start).count() / max(1LL, operations);
+    if (perf && counters.isAvailable()) printCounterRatios(values, operations);
+    cout << endl;
+}
+
+// Cost of the hot-loop components by themselves: random engines, the whole
+// model per event, packet-service buffer scans and calendar push/pop
+void benchmarkComponents(const ModelConfig& config, double max_time) {
+    const int calls = 10000000;
+    const int scans = 2000000;
+    bool perf = config.perf_counters;
+    bool available = HardwareCounters().isAvailable();
+
+    cout << "\n--- PER-OPERATION COSTS ---" << endl;
+    if (perf && !available) cout << "Hardware counters unavailable (perf_event_open refused, or not Linux)" << endl;
+    cout << setw(32) << "Case" << setw(12) << "Operations" << setw(10) << "ns/op";
+    if (perf && available) printCounterHeader();
+    cout << endl;
+
+    benchmarkCase(string("RNG ") + StreamFactory<default_random_engine>::name(), perf, [&]() -> long long {
+        engineNsPerCall<default_random_engine>(config.seed, calls);
+        return calls;
+    });
+    benchmarkCase(string("RNG ") + StreamFactory<Xoshiro256PlusPlus>::name(), perf, [&]() -> long long {
+        engineNsPerCall<Xoshiro256PlusPlus>(config.seed, calls);
+        return calls;
+    });
+    benchmarkCase(string("RNG ") + StreamFactory<Pcg64>::name(), perf, [&]() -> long long {
+        engineNsPerCall<Pcg64>(config.seed, calls);
+        return calls;
+    });
+    benchmarkCase("Model event (default engine)", perf, [&]() -> long long {
+        long long events = 0;
+        modelEventsPerSecond<default_random_engine>(config, max_time, events);
+        return events;
+    });
+    benchmarkCase("Model event (xoshiro256++)", perf, [&]() -> long long {
+        long long events = 0;
+        modelEventsPerSecond<Xoshiro256PlusPlus>(config, max_time, events);
+        return events;
+    });
+
+    // Full buffer of the configured size: take the packet's next request, put it back
+    benchmarkCase("Buffer scan (size " + to_string(config.buffer_size) + ")", perf, [&]() -> long long {
+        StreamBuffer buffer(config.buffer_size, BufferSlotSourceOf());
+        for (int i = 0; i < config.buffer_size; i++) {
+            BufferSlot slot = { i % config.getNumSources(), (double)i };
+            buffer.addRequest(slot);
+        }
+        int serving_source = -1;
+        BufferSlot slot;
+        for (int i = 0; i < scans; i++) {
+            if (buffer.getNextRequest(serving_source, slot)) buffer.addRequest(slot);
+        }
+        benchmark_sink = serving_source;
+        return scans;
+    });
+
+    // Calendar holding one event per source and device, as in the model
+    benchmarkCase("Calendar pop + push", perf, [&]() -> long long {
+        priority_queue<Event, vector<Event>, greater<Event>> calendar;
+        Xoshiro256PlusPlus gen = StreamFactory<Xoshiro256PlusPlus>::make(config.seed, 0, 0);
+        int size = config.getNumSources() + config.getNumDevices();
+        for (int i = 0; i < size; i++) calendar.push(Event(uniformDouble(gen), Event::ARRIVAL, i));
+        for (int i = 0; i < calls; i++) {
+            Event event = calendar.top();
+            calendar.pop();
+            calendar.push(Event(event.time + uniformDouble(gen), Event::ARRIVAL, event.entity_id));
+        }
+        benchmark_sink = calendar.top().time;
+        return calls;
+    });
+}
+
+// Engine benchmark mode (--bench-rng): raw throughput and events/second inside run()
+void benchmarkEngines(ModelConfig config) {
+    const double max_time = 1000000.0;
+    config.seed = config.resolveSeed();
+
+    cout << "=== RANDOM ENGINE BENCHMARK (model time " << fixed << setprecision(0)
+        << max_time << ", seed " << config.seed << ") ===" << endl;
+    cout << setw(24) << "Engine" << setw(12) << "ns/call" << setw(12) << "Events"
+        << setw(16) << "Events/s (std)" << setw(16) << "Events/s (zig)" << endl;
+
+    benchmarkEngine<default_random_engine>(config, max_time);
+    benchmarkEngine<Xoshiro256PlusPlus>(config, max_time);
+    benchmarkEngine<Pcg64>(config, max_time);
+
+    benchmarkComponents(config, max_time);
+}
+
+// Heap calls of one model per phase of a run: construction, warm-up (ending
+// with the statistics reset), steady state and reporting. True if the steady
+// state did not allocate
+template <typename Model>
+bool checkModelAllocations(const string& name, const ModelConfig& config, double warmup, double horizon) {
+    const char* phases[] = { "Construction", "Warm-up", "Steady state", "Reporting" };
+    AllocationCounts counts[5];
+    long long events = 0;
+
+    counts[0] = getAllocationCounts();
+    Model* model = new Model(config);
+    counts[1] = getAllocationCounts();
+    model->simulate(warmup, INT_MAX);
+    model->resetStatistics();
+    counts[2] = getAllocationCounts();
+    events = model->simulate(model->getCurrentTime() + horizon, INT_MAX);
+    counts[3] = getAllocationCounts();
+    ostringstream report; // results are not shown, only their cost counted
+    streambuf* saved = cout.rdbuf(report.rdbuf());
+    model->printResults();
+    cout.rdbuf(saved);
+    counts[4] = getAllocationCounts();
+    delete model;
+
+    cout << name << " (" << events << " steady-state events)" << endl;
+    for (int phase = 0; phase < 4; phase++) {
+        cout << setw(16) << phases[phase]
+            << setw(14) << counts[phase + 1].allocations - counts[phase].allocations
+            << setw(16) << counts[phase + 1].deallocations - counts[phase].deallocations
+            << setw(14) << counts[phase + 1].bytes - counts[phase].bytes << endl;
+    }
+    return counts[3].allocations == counts[2].allocations;
+}
+
+// Zero-allocation check (--check-allocations): the steady-state event loop of
+// both models must not touch the heap. Needs the instrumentation build
+template <typename Engine>
+bool checkAllocations(ModelConfig config, double warmup, double horizon) {
+    if (!allocation_accounting) {
+        cout << "Allocation accounting is off: build with ALLOCATION_ACCOUNTING defined" << endl;
+        return false;
+    }
+    config.seed = config.resolveSeed();
+
+    cout << "=== ALLOCATION ACCOUNTING (warm-up " << warmup << ", horizon " << horizon
+        << ", seed " << config.seed << ") ===" << endl;
+    cout << setw(16) << "Phase" << setw(14) << "Allocations" << setw(16) << "Deallocations"
+        << setw(14) << "Bytes" << endl;
+    bool model_ok = checkModelAllocations<BasicSimulationModel<Engine>>("SimulationModel",
+        config, warmup, horizon);
+    bool streaming_ok = checkModelAllocations<BasicStreamingModel<Engine>>("StreamingModel",
+        config, warmup, horizon);
+
+    cout << "Steady state allocation-free: SimulationModel " << (model_ok ? "PASS" : "FAIL")
+        << ", StreamingModel " << (streaming_ok ? "PASS" : "FAIL") << endl;
+    return model_ok && streaming_ok;
+}
+
+// Replication setup benchmark (--bench-reset): short replications with a new
+// model each against one model reset in place, both at one fixed replication
+// (setup alone) and over successive replications (setup plus reaching each
+// start state; the xoshiro starts are cached, so neither path pays O(r) jumps)
+void benchmarkReset(ModelConfig config) {
+    const int replications = 500;
+    const double max_time = 100.0;
+    config.engine = ENGINE_XOSHIRO;
+    config.prefetch = false;
+    config.seed = config.resolveSeed();
+    StreamFactory<Xoshiro256PlusPlus>::make(config.seed, config.replication + replications, 0); // fills the cache
+
+    cout << "=== REPLICATION SETUP BENCHMARK (" << replications << " replications of "
+        << max_time << " units, seed " << config.seed << ") ===" << endl;
+    cout << setw(14) << "Replications" << setw(16) << "Mode" << setw(16) << "us/replication"
+        << setw(14) << "Allocations" << endl;
+
+    bool same = true;
+    for (int successive = 0; successive <= 1; successive++) {
+        double check_fresh = 0, check_reset = 0;
+        for (int reuse = 0; reuse <= 1; reuse++) {
+            BasicSimulationModel<Xoshiro256PlusPlus> reused(config);
+            AllocationCounts before = getAllocationCounts();
+            auto start = chrono::steady_clock::now();
+            double check = 0;
+            for (int r = 0; r < replications; r++) {
+                int replication = config.replication + (successive ? r : 0);
+                if (reuse) {
+                    reused.reset(config.seed, replication);
+                    reused.simulate(max_time, INT_MAX);
+                    check += reused.getStatistics().getRejectProbability(0);
+                }
+                else {
+                    ModelConfig rep_config = config;
+                    rep_config.replication = replication;
+                    BasicSimulationModel<Xoshiro256PlusPlus> model(rep_config);
+                    model.simulate(max_time, INT_MAX);
+                    check += model.getStatistics().getRejectProbability(0);
+                }
+            }
+            double elapsed = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+            AllocationCounts after = getAllocationCounts();
+            (reuse ? check_reset : check_fresh) = check;
+
+            cout << setw(14) << (successive ? "successive" : "fixed") << setw(16) << (reuse ? "reset(seed)" : "new model")
+                << setw(16) << fixed << setprecision(2) << elapsed / replications;
+            if (allocation_accounting) {
+                cout << setw(14) << after.allocations - before.allocations;
+            }
+            else {
+                cout << setw(14) << "n/a";
+            }
+            cout << endl;
+        }
+        same = same && check_fresh == check_reset;
+    }
+    cout << "Same results: " << (same ? "yes" : "NO") << endl;
+}
+
+// Interleaved engine benchmark (--bench-interleave N): a heterogeneous batch
+// of N models (device count, buffer size and device speed all differ) run one
+// after another against simulateInterleaved with several slice lengths
+void benchmarkInterleave(ModelConfig config, int count) {
+    const double max_time = 20000.0;
+    const int turns[] = { 1, 4, 16, 64 };
+    config.engine = ENGINE_XOSHIRO;
+    config.prefetch = false;
+    config.seed = config.resolveSeed();
+
+    vector<ModelConfig> configs(count, config);
+    for (int m = 0; m < count; m++) {
+        configs[m].setNumDevices(1 + m % 4);
+        configs[m].buffer_size = 4 << (m / 4 % 5);
+        for (double& mean : configs[m].device_mean_times) mean *= 1.0 + 0.05 * (m % 7);
+        configs[m].replication = m;
+    }
+
+    cout << "=== INTERLEAVED ENGINE BENCHMARK (" << count << " models, model time "
+        << fixed << setprecision(0) << max_time << ", seed " << config.seed << ") ===" << endl;
+    cout << setw(20) << "Mode" << setw(14) << "Events" << setw(16) << "Events/s" << setw(10) << "Same" << endl;
+
+    vector<double> reference;
+    for (int mode = -1; mode < (int)(sizeof(turns) / sizeof(turns[0])); mode++) {
+        vector<BasicSimulationModel<Xoshiro256PlusPlus>*> models;
+        for (const ModelConfig& model_config : configs) {
+            models.push_back(new BasicSimulationModel<Xoshiro256PlusPlus>(model_config));
+        }
+
+        auto start = chrono::steady_clock::now();
+        long long events = 0;
+        if (mode < 0) {
+            for (auto model : models) events += model->simulate(max_time, INT_MAX);
+        }
+        else {
+            events = simulateInterleaved(models, max_time, INT_MAX, turns[mode]);
+        }
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        vector<double> results;
+        for (auto model : models) {
+            results.push_back(model->getStatistics().getRejectProbability(0));
+            results.push_back(model->getCurrentTime());
+            delete model;
+        }
+        if (mode < 0) reference = results;
+
+        ostringstream name;
+        if (mode < 0) name << "sequential";
+        else name << "interleaved x" << turns[mode];
+        cout << setw(20) << name.str() << setw(14) << events
+            << setw(16) << fixed << setprecision(0) << events / elapsed
+            << setw(10) << (results == reference ? "yes" : "NO") << endl;
+    }
+}
+
+// Specialized model mode (--codegen): replications of the configuration with
+// the generated shared object against the generic SimulationModel, or the
+// generic model alone when the specialized one is unavailable
+void runSpecialized(ModelConfig config, const string& cache_dir, int replications, double horizon) {
+    config.seed = config.resolveSeed();
+
+    cout << "=== SPECIALIZED MODEL (" << replications << " replications of " << fixed
+        << setprecision(0) << horizon << " units, seed " << config.seed << ") ===" << endl;
+    auto build_start = chrono::steady_clock::now();
+    SpecializedModel specialized(config, cache_dir);
+    double build_time = chrono::duration<double>(chrono::steady_clock::now() - build_start).count();
+    cout << "Specialized model: " << specialized.getStatus() << " (" << setprecision(3)
+        << build_time << " s)" << endl;
+    if (!specialized.isAvailable()) {
+        cout << "Falling back to the generic SimulationModel" << endl;
+    }
+
+    cout << setw(16) << "Path" << setw(14) << "Events" << setw(16) << "Events/s" << endl;
+    vector<SpecializedResults> generic_results(replications);
+    for (int path = 0; path <= (specialized.isAvailable() ? 1 : 0); path++) {
+        long long events = 0;
+        double reject_sum = 0;
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < replications; r++) {
+            ModelConfig rep_config = config;
+            rep_config.replication = r;
+            SpecializedResults results;
+            if (path == 0) {
+                BasicSimulationModel<Xoshiro256PlusPlus> model(rep_config);
+                events += model.simulate(horizon, INT_MAX);
+                generic_results[r] = results = resultsOf(model);
+            }
+            else {
+                events += specialized.simulate(makeModelStreams<Xoshiro256PlusPlus>(rep_config),
+                    horizon, INT_MAX, results);
+                if (!(results == generic_results[r])) {
+                    cout << "Replication " << r << " differs from the generic model" << endl;
+                }
+            }
+            reject_sum += (double)results.source_rejections[0] / max(1, results.source_requests[0]);
+        }
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << setw(16) << (path == 0 ? "generic" : "specialized") << setw(14) << events
+            << setw(16) << setprecision(0) << events / elapsed
+            << "   P_reject(1) = " << setprecision(4) << reject_sum / replications << endl;
+    }
+}
+
+// Tau-leaping mode (--tau-leap): approximate run of the configuration over horizon
+void runTauLeap(ModelConfig config, double horizon, double epsilon) {
+    config.seed = config.resolveSeed();
+    printModelHeader("SIMULATION MODEL VARIANT 6 (TAU-LEAPING, APPROXIMATE)", config, horizon, INT_MAX);
+    if (config.arrivals != ARRIVALS_EXPONENTIAL) {
+        cout << "Note: uniform sources are approximated by Poisson sources of the same mean" << endl;
+    }
+
+    auto start = chrono::steady_clock::now();
+    TauLeapModel model(config, epsilon);
+    model.simulate(horizon);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    model.printResults();
+    cout << "\n--- TAU-LEAPING ---" << endl;
+    cout << "Epsilon: " << epsilon << ", leaps: " << model.getLeaps()
+        << ", exact steps: " << model.getExactSteps() << ", wall time: "
+        << setprecision(3) << elapsed << " s" << endl;
+}
+
+// Fluid mode (--fluid): the fluid approximation over horizon, compared with
+// the event model (xoshiro256++ streams, same horizon) when the load is constant
+void compareFluid(ModelConfig config, double horizon, double step_size, double amplitude, double period) {
+    config.seed = config.resolveSeed();
+    config.engine = ENGINE_XOSHIRO;
+    printModelHeader("SIMULATION MODEL VARIANT 6 (FLUID APPROXIMATION)", config, horizon, INT_MAX);
+    cout << "Fluid step: " << step_size;
+    if (period > 0) cout << ", load 1 + " << amplitude << " sin(2 pi t / " << period << ")";
+    cout << endl;
+
+    auto start = chrono::steady_clock::now();
+    FluidModel fluid(config, step_size, amplitude, period);
+    fluid.simulate(horizon);
+    double fluid_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    bool compare = period <= 0;
+    unique_ptr<BasicSimulationModel<Xoshiro256PlusPlus>> model;
+    double model_time = 0;
+    long long events = 0;
+    if (compare) {
+        start = chrono::steady_clock::now();
+        model.reset(new BasicSimulationModel<Xoshiro256PlusPlus>(config));
+        events = model->simulate(horizon, INT_MAX);
+        model_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    else {
+        cout << "Time-varying load: no event model comparison" << endl;
+    }
+
+    cout << "\n--- SOURCE CHARACTERISTICS (fluid" << (compare ? " / simulation" : "") << ") ---" << endl;
+    cout << setw(10) << "Source" << setw(20) << "P_reject" << setw(20) << "T_total" << setw(20) << "T_wait" << endl;
+    for (int s = 0; s < config.getNumSources(); s++) {
+        cout << setw(10) << "S" + to_string(s + 1);
+        double fluid_values[] = { fluid.getRejectProbability(s), fluid.getAverageTotalTime(s),
+            fluid.getAverageWaitingTime(s) };
+        for (int v = 0; v < 3; v++) {
+            ostringstream cell;
+            if (v > 0 && !fluid.hasThroughput(s)) {
+                cell << "n/a"; // nothing of s was served
+            }
+            else {
+                cell << fixed << setprecision(v == 0 ? 3 : 2) << fluid_values[v];
+            }
+            if (compare) {
+                const SimulationStatistics& stats = model->getStatistics();
+                double simulated = v == 0 ? stats.getRejectProbability(s) :
+                    v == 1 ? stats.getAverageTotalTime(s) : stats.getAverageWaitingTime(s);
+                cell << " / " << simulated;
+            }
+            cout << setw(20) << cell.str();
+        }
+        cout << endl;
+    }
+
+    vector<int> device_order;
+    vector<DeviceGroup> groups = groupDevices(config, (int)fluid.getGroups().size(), &device_order);
+    cout << "\n--- DEVICE CHARACTERISTICS (by class) ---" << endl;
+    cout << setw(20) << "Devices" << setw(20) << "Utilization" << endl;
+    for (size_t k = 0; k < groups.size(); k++) {
+        ostringstream cell;
+        cell << fixed << setprecision(3) << fluid.getUtilization((int)k);
+        if (compare) {
+            double sum = 0;
+            for (int i = groups[k].first_device; i < groups[k].first_device + groups[k].count; i++) {
+                sum += model->getStatistics().getUtilization(device_order[i], model->getCurrentTime());
+            }
+            cell << " / " << sum / groups[k].count;
+        }
+        cout << setw(20) << groups[k].getName() << setw(20) << cell.str() << endl;
+    }
+
+    fluid.printTrajectory();
+
+    cout << "\n--- RUNTIME ---" << endl;
+    cout << "Fluid: " << fluid.getSteps() << " steps, " << setprecision(4) << fluid_time << " s" << endl;
+    if (compare) {
+        cout << "Simulation: " << events << " events, " << setprecision(4) << model_time << " s" << endl;
+    }
+}
+
+// Matrix-analytic mode (--qbd): totals of the exponential variant from the
+// QBD solver, next to the event model over horizon
+void runQbd(ModelConfig config, double horizon) {
+    config.seed = config.resolveSeed();
+    config.engine = ENGINE_XOSHIRO;
+    config.arrivals = ARRIVALS_EXPONENTIAL;
+    printModelHeader("SIMULATION MODEL VARIANT 6 (MATRIX-ANALYTIC QBD)", config, horizon, INT_MAX);
+
+    QbdSolver solver(config);
+    if (!solver.isSupported()) {
+        cout << "QBD solver needs 1 to 7 devices and a buffer of at least 1" << endl;
+        return;
+    }
+    auto start = chrono::steady_clock::now();
+    solver.solve();
+    double solve_time = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    BasicSimulationModel<Xoshiro256PlusPlus> model(config);
+    long long events = model.simulate(horizon, INT_MAX);
+    double model_time = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    const SimulationStatistics& stats = model.getStatistics();
+
+    // Waits by Little's law over served requests (time of pushed-out requests included)
+    double throughput = solver.getArrivalRate() * (1 - solver.p_full);
+    double busy = 0;
+    for (double u : solver.utilization) busy += u;
+    double simulated_buffered = 0, simulated_busy = 0, simulated_wait = 0, simulated_total = 0;
+    for (int i = 0; i < config.getNumSources(); i++) {
+        simulated_buffered += stats.buffer_occupancy[i].getMean(model.getCurrentTime());
+        simulated_wait += stats.source_waiting_time[i];
+        simulated_total += stats.source_total_time[i];
+    }
+    for (int j = 0; j < config.getNumDevices(); j++) {
+        simulated_busy += stats.getUtilization(j, model.getCurrentTime());
+    }
+
+    cout << "\n--- TOTALS (QBD / simulation) ---" << endl;
+    cout << setw(24) << "P_reject" << setw(12) << fixed << setprecision(4) << solver.p_full
+        << setw(12) << (double)stats.requests_rejected / max(1, stats.requests_generated) << endl;
+    cout << setw(24) << "Mean buffered" << setw(12) << solver.mean_buffered
+        << setw(12) << simulated_buffered << endl;
+    double simulated_throughput = (double)max(1, stats.requests_served) / model.getCurrentTime();
+    cout << setw(24) << "T_wait (Little)" << setw(12) << solver.mean_buffered / throughput
+        << setw(12) << simulated_buffered / simulated_throughput << endl;
+    cout << setw(24) << "T_total (Little)" << setw(12) << (solver.mean_buffered + busy) / throughput
+        << setw(12) << (simulated_buffered + simulated_busy) / simulated_throughput << endl;
+    cout << setw(24) << "T_wait (served)" << setw(12) << "n/a"
+        << setw(12) << simulated_wait / max(1, stats.requests_served) << endl;
+    cout << setw(24) << "T_total (served)" << setw(12) << "n/a"
+        << setw(12) << simulated_total / max(1, stats.requests_served) << endl;
+
+    cout << "\n--- DEVICE CHARACTERISTICS (QBD / simulation) ---" << endl;
+    cout << setw(10) << "Device" << setw(15) << "Utilization" << endl;
+    for (int j = 0; j < config.getNumDevices(); j++) {
+        cout << setw(10) << "D" + to_string(j + 1) << setw(15) << solver.utilization[j]
+            << setw(12) << stats.getUtilization(j, model.getCurrentTime()) << endl;
+    }
+
+    cout << "\n--- RUNTIME ---" << endl;
+    cout << "QBD: " << setprecision(3) << solve_time << " ms (" << solver.getIterations()
+        << " logarithmic reduction steps)" << endl;
+    cout << "Simulation: " << events << " events, " << setprecision(1) << model_time << " ms" << endl;
+}
+
+// Design-of-experiments mode (--doe lhs|sobol): a space-filling design over
+// every source interval, device mean and the buffer size, evaluated in parallel
+// with replications; one CSV row per run (point, replication, factor values,
+// outputs) for metamodel fitting and sensitivity analysis
+void runDesign(ModelConfig config, const string& method, int num_points, double spread,
+    const string& out_path, int replications, double warmup, double horizon) {
+    config.engine = ENGINE_XOSHIRO;
+    config.prefetch = false;
+    config.seed = config.resolveSeed();
+    vector<DesignFactor> factors = makeDesignFactors(config, spread);
+    int dimensions = (int)factors.size();
+
+    vector<vector<double>> design;
+    if (method == "sobol") {
+        if (dimensions > SobolSequence::MAX_DIMENSIONS) {
+            cout << "Sobol designs support up to " << SobolSequence::MAX_DIMENSIONS << " factors, "
+                << dimensions << " requested" << endl;
+            return;
+        }
+        SobolSequence sequence(dimensions, config.seed);
+        for (int i = 0; i < num_points; i++) design.push_back(sequence.next());
+    }
+    else {
+        design = latinHypercube(num_points, dimensions, config.seed);
+    }
+
+    cout << "=== DESIGN OF EXPERIMENTS (" << (method == "sobol" ? "scrambled Sobol" : "Latin hypercube")
+        << ", " << num_points << " points x " << replications << " replications, horizon " << horizon
+        << ", warm-up " << warmup << ", seed " << config.seed << ") ===" << endl;
+    cout << "\n--- FACTORS ---" << endl;
+    cout << setw(14) << "Factor" << setw(10) << "Low" << setw(10) << "High" << endl;
+    for (const auto& factor : factors) {
+        cout << setw(14) << factor.getName() << setw(10) << fixed << setprecision(3) << factor.low
+            << setw(10) << factor.high << endl;
+    }
+    cout << "Centered L2 discrepancy of the design: " << setprecision(5) << centeredDiscrepancy(design) << endl;
+
+    auto t0 = chrono::steady_clock::now();
+    vector<vector<double>> outputs = evaluateDesign(config, factors, design, replications, warmup, horizon);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    ofstream out(out_path);
+    if (!out) {
+        cout << "Cannot write " << out_path << endl;
+        return;
+    }
+    vector<string> names = getDesignOutputNames(config);
+    out << "point,replication";
+    for (const auto& factor : factors) out << "," << factor.getName();
+    for (const auto& name : names) out << "," << name;
+    out << "\n" << setprecision(10);
+    for (size_t run = 0; run < outputs.size(); run++) {
+        int point = (int)run / replications;
+        out << point << "," << run % replications;
+        for (size_t k = 0; k < factors.size(); k++) out << "," << factors[k].getValue(design[point][k]);
+        for (double value : outputs[run]) out << "," << value;
+        out << "\n";
+    }
+
+    cout << "\n--- RESULTS ---" << endl;
+    cout << outputs.size() << " runs on " << parallelWorkers((int)outputs.size()) << " threads in "
+        << setprecision(2) << seconds << " s, written to " << out_path << endl;
+    cout << setw(14) << "Output" << setw(10) << "Min" << setw(10) << "Mean" << setw(10) << "Max" << endl;
+    for (size_t k = 0; k < names.size(); k++) {
+        double low = outputs[0][k], high = low, sum = 0;
+        for (const auto& run : outputs) {
+            low = min(low, run[k]);
+            high = max(high, run[k]);
+            sum += run[k];
+        }
+        cout << setw(14) << names[k] << setw(10) << setprecision(4) << low << setw(10)
+            << sum / outputs.size() << setw(10) << high << endl;
+    }
+}
+
+// First-order and total-effect Sobol indices of every factor from the Saltelli
+// estimators (Saltelli 2010 first order, Jansen total effect) over the rows in
+// sample of f(A), f(B) and f(AB_k) (A with column k taken from B)
+void sobolIndices(const vector<double>& f_a, const vector<double>& f_b, const vector<vector<double>>& f_ab,
+    const vector<int>& sample, vector<double>& first_order, vector<double>& total_effect) {
+    double n = (double)sample.size();
+    double sum = 0, sq_sum = 0;
+    for (int i : sample) {
+        sum += f_a[i] + f_b[i];
+        sq_sum += f_a[i] * f_a[i] + f_b[i] * f_b[i];
+    }
+    double mean = sum / (2 * n);
+    double variance = sq_sum / (2 * n) - mean * mean;
+    first_order.assign(f_ab.size(), 0);
+    total_effect.assign(f_ab.size(), 0);
+    if (!(variance > 0)) return; // also an empty sample (NaN)
+    for (size_t k = 0; k < f_ab.size(); k++) {
+        double first = 0, total = 0;
+        for (int i : sample) {
+            first += f_b[i] * (f_ab[k][i] - f_a[i]);
+            total += (f_a[i] - f_ab[k][i]) * (f_a[i] - f_ab[k][i]);
+        }
+        first_order[k] = first / n / variance;
+        total_effect[k] = total / (2 * n) / variance;
+    }
+}
+
+// Sensitivity mode (--sensitivity): Sobol indices of one design output over
+// the design factors. Base matrices A and B are the two halves of a scrambled
+// Sobol sequence in 2d dimensions (two Latin hypercubes beyond its dimensions);
+// A, B and the d matrices AB_k are evaluated in parallel with --replications
+// common random numbers per point, the replication means taken as the model
+// output. 95% intervals are bootstrap percentiles over the base rows
+void runSensitivity(ModelConfig config, int num_samples, double spread, const string& output_name,
+    int num_bootstrap, int replications, double warmup, double horizon) {
+    config.engine = ENGINE_XOSHIRO;
+    config.prefetch = false;
+    config.seed = config.resolveSeed();
+    vector<DesignFactor> factors = makeDesignFactors(config, spread);
+    int dimensions = (int)factors.size();
+    vector<string> names = getDesignOutputNames(config);
+    int output = (int)(find(names.begin(), names.end(), output_name) - names.begin());
+    if (output == (int)names.size()) {
+        cout << "Unknown output: " << output_name << endl;
+        return;
+    }
+
+    vector<vector<double>> a, b;
+    bool sobol = 2 * dimensions <= SobolSequence::MAX_DIMENSIONS;
+    if (sobol) {
+        SobolSequence sequence(2 * dimensions, config.seed);
+        for (int i = 0; i < num_samples; i++) {
+            vector<double> point = sequence.next();
+            a.push_back(vector<double>(point.begin(), point.begin() + dimensions));
+            b.push_back(vector<double>(point.begin() + dimensions, point.end()));
+        }
+    }
+    else {
+        a = latinHypercube(num_samples, dimensions, config.seed);
+        b = latinHypercube(num_samples, dimensions, config.seed + 1);
+    }
+    vector<vector<double>> design(a);
+    design.insert(design.end(), b.begin(), b.end());
+    for (int k = 0; k < dimensions; k++) {
+        for (int i = 0; i < num_samples; i++) {
+            design.push_back(a[i]);
+            design.back()[k] = b[i][k];
+        }
+    }
+
+    cout << "=== SENSITIVITY ANALYSIS (" << names[output] << ", " << dimensions << " factors, "
+        << num_samples << " base samples " << (sobol ? "(scrambled Sobol)" : "(Latin hypercube)")
+        << " x " << dimensions + 2 << " matrices x " << replications << " replications, horizon "
+        << horizon << ", seed " << config.seed << ") ===" << endl;
+    auto t0 = chrono::steady_clock::now();
+    vector<vector<double>> outputs = evaluateDesign(config, factors, design, replications, warmup, horizon);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    // Replication means of the selected output, split into f(A), f(B), f(AB_k)
+    vector<double> means(design.size(), 0);
+    for (size_t run = 0; run < outputs.size(); run++) means[run / replications] += outputs[run][output] / replications;
+    vector<double> f_a(means.begin(), means.begin() + num_samples);
+    vector<double> f_b(means.begin() + num_samples, means.begin() + 2 * num_samples);
+    vector<vector<double>> f_ab;
+    for (int k = 0; k < dimensions; k++) {
+        f_ab.push_back(vector<double>(means.begin() + (2 + k) * num_samples, means.begin() + (3 + k) * num_samples));
+    }
+
+    vector<int> sample(num_samples);
+    for (int i = 0; i < num_samples; i++) sample[i] = i;
+    vector<double> first_order, total_effect;
+    sobolIndices(f_a, f_b, f_ab, sample, first_order, total_effect);
+
+    vector<vector<double>> first_boot(dimensions), total_boot(dimensions);
+    Xoshiro256PlusPlus gen(config.seed);
+    uniform_int_distribution<int> pick(0, num_samples - 1);
+    for (int r = 0; r < num_bootstrap; r++) {
+        for (int& i : sample) i = pick(gen);
+        vector<double> first, total;
+        sobolIndices(f_a, f_b, f_ab, sample, first, total);
+        for (int k = 0; k < dimensions; k++) {
+            first_boot[k].push_back(first[k]);
+            total_boot[k].push_back(total[k]);
+        }
+    }
+    auto percentile = [](vector<double>& values, double q) {
+        if (values.empty()) return 0.0;
+        sort(values.begin(), values.end());
+        return values[min(values.size() - 1, (size_t)(q * values.size()))];
+    };
+
+    cout << design.size() * replications << " runs on " << parallelWorkers((int)outputs.size())
+        << " threads in " << fixed << setprecision(2) << seconds << " s" << endl;
+    cout << "\n--- SOBOL INDICES (95% bootstrap intervals, " << num_bootstrap << " resamples) ---" << endl;
+    cout << setw(14) << "Factor" << setw(10) << "Low" << setw(10) << "High" << setw(10) << "S_first"
+        << setw(20) << "interval" << setw(10) << "S_total" << setw(20) << "interval" << endl;
+    double first_sum = 0;
+    for (int k = 0; k < dimensions; k++) {
+        first_sum += first_order[k];
+        cout << setw(14) << factors[k].getName() << setw(10) << setprecision(3) << factors[k].low
+            << setw(10) << factors[k].high << setw(10) << first_order[k]
+            << "  [" << setw(7) << percentile(first_boot[k], 0.025) << ", " << setw(7)
+            << percentile(first_boot[k], 0.975) << "]" << setw(10) << total_effect[k]
+            << "  [" << setw(7) << percentile(total_boot[k], 0.025) << ", " << setw(7)
+            << percentile(total_boot[k], 0.975) << "]" << endl;
+    }
+    cout << "Sum of first-order indices: " << first_sum
+        << " (below 1 by the share of interactions)" << endl;
+}
+
+// Reads the design CSV and fits the metamodel of one output, with a summary
+bool loadMetamodel(const string& csv_path, const string& output_name, DesignData& data, GaussianProcess& model) {
+    string error;
+    if (!readDesignCsv(csv_path, output_name, data, error)) {
+        cout << "Metamodel: " << error << endl;
+        return false;
+    }
+    auto t0 = chrono::steady_clock::now();
+    if (!model.fit(data, true)) {
+        cout << "Metamodel: covariance matrix of " << csv_path << " is not positive definite" << endl;
+        return false;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << "Gaussian process for " << output_name << " fitted to " << model.getPoints() << " points of "
+        << csv_path << " in " << fixed << setprecision(3) << seconds << " s (log-likelihood "
+        << setprecision(2) << model.getLogLikelihood() << ", signal sd " << setprecision(4)
+        << model.getSignalSd() << ")" << endl;
+    cout << setw(14) << "Factor" << setw(14) << "Length scale" << endl;
+    for (size_t k = 0; k < data.factor_names.size(); k++) {
+        cout << setw(14) << data.factor_names[k] << setw(14) << setprecision(4) << model.getLengthScale((int)k) << endl;
+    }
+    return true;
+}
+
+// Metamodel mode (--metamodel FILE): fits the Gaussian process to stored design
+// results and reports its leave-one-out accuracy, the calibration of its
+// uncertainty and the cost of a prediction
+void runMetamodel(const string& csv_path, const string& output_name) {
+    cout << "=== METAMODEL ===" << endl;
+    DesignData data;
+    GaussianProcess model;
+    if (!loadMetamodel(csv_path, output_name, data, model)) return;
+
+    vector<double> residuals, sds;
+    model.leaveOneOut(residuals, sds);
+    double sq_sum = 0, y_sum = 0, y_sq_sum = 0, sd_sum = 0;
+    int covered = 0;
+    int n = (int)residuals.size();
+    for (int i = 0; i < n; i++) {
+        sq_sum += residuals[i] * residuals[i];
+        sd_sum += sds[i];
+        covered += fabs(residuals[i]) <= 1.96 * sds[i] ? 1 : 0;
+        y_sum += data.means[i];
+        y_sq_sum += data.means[i] * data.means[i];
+    }
+    double y_variance = y_sq_sum / n - (y_sum / n) * (y_sum / n);
+    cout << "\n--- LEAVE-ONE-OUT VALIDATION ---" << endl;
+    cout << "RMSE " << setprecision(5) << sqrt(sq_sum / n) << " (output sd " << sqrt(max(0.0, y_variance))
+        << "), Q2 " << setprecision(4) << 1 - sq_sum / n / max(y_variance, 1e-300) << endl;
+    cout << "Mean predictive sd " << setprecision(5) << sd_sum / n << ", 95% interval coverage "
+        << setprecision(1) << 100.0 * covered / n << "%" << endl;
+
+    // Predictions at random points of the design's range
+    const int num_queries = 100000;
+    Xoshiro256PlusPlus gen(1);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    vector<vector<double>> queries(num_queries, vector<double>(data.factor_names.size()));
+    for (auto& query : queries) {
+        for (size_t k = 0; k < query.size(); k++) {
+            query[k] = data.inputs[gen() % data.inputs.size()][k] * (0.9 + 0.2 * uniform(gen));
+        }
+    }
+    double mean, sd, sink = 0;
+    auto t0 = chrono::steady_clock::now();
+    for (const auto& query : queries) {
+        model.predict(query, mean, sd);
+        sink += mean + sd;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    benchmark_sink = sink;
+    cout << "\n--- PREDICTION COST ---" << endl;
+    cout << setprecision(3) << 1e6 * seconds / num_queries << " us per prediction with uncertainty ("
+        << num_queries << " queries)" << endl;
+}
+
+#ifdef __linux__
+// What-if query server (--serve SOCKET): answers line requests on a Unix domain
+// socket from the Gaussian process of a design CSV, one thread per client.
+//   predict v1 ... vd  ->  ok <mean> <sd> [simulating]
+//   info               ->  ok <points> <output> <factor names>
+//   shutdown           ->  ok (stops the server)
+// Factor values are in the CSV's units and order. A prediction whose sd exceeds
+// the threshold queues a background simulation of that point (the --doe
+// factors and run length); its replications are appended to the CSV and the
+// metamodel is refitted with the same hyperparameters, so the answer to the
+// next query there is sharper. The CSV does not record its seed, so background
+// simulations need --seed, which should be the design's: replication r then
+// shares its streams with replication r of the CSV (common random numbers)
+class MetamodelServer {
+private:
+    ModelConfig base;
+    vector<DesignFactor> factors;
+    bool can_simulate; // the CSV factors are the --doe factors of this configuration, --seed given
+    string csv_path;
+    string output_name;
+    int output_index;  // in getDesignOutputs
+    double max_sd;
+    int replications;
+    double warmup;
+    double horizon;
+
+    DesignData data;                          // owned by the simulation thread after start
+    shared_ptr<const GaussianProcess> model;  // swapped under model_mutex
+    mutex model_mutex;
+
+    deque<vector<double>> pending;
+    set<vector<double>> queued;               // pending or running points
+    mutex queue_mutex;
+    condition_variable queue_ready;
+    atomic<bool> stopping;
+    atomic<long long> num_queries;
+    atomic<int> num_simulated;
+    int listen_fd;
+
+    // Client threads by id (used by the accept loop only), the sockets of the
+    // connected clients and the ids of finished threads, under clients_mutex
+    map<int, thread> clients;
+    map<int, int> client_fds;
+    vector<int> finished_clients;
+    mutex clients_mutex;
+
+    shared_ptr<const GaussianProcess> getModel() {
+        lock_guard<mutex> lock(model_mutex);
+        return model;
+    }
+
+    // Stops accepting and wakes every client blocked in recv
+    void stop() {
+        lock_guard<mutex> lock(clients_mutex);
+        stopping = true;
+        ::shutdown(listen_fd, SHUT_RDWR);
+        for (const auto& client : client_fds) ::shutdown(client.second, SHUT_RDWR);
+    }
+
+    void joinFinishedClients() {
+        vector<int> finished;
+        {
+            lock_guard<mutex> lock(clients_mutex);
+            finished.swap(finished_clients);
+        }
+        for (int id : finished) {
+            clients[id].join();
+            clients.erase(id);
+        }
+    }
+
+    void simulatePending() {
+        while (true) {
+            vector<double> point;
+            {
+                unique_lock<mutex> lock(queue_mutex);
+                queue_ready.wait(lock, [&]() { return stopping || !pending.empty(); });
+                if (stopping) return;
+                point = pending.front();
+                pending.pop_front();
+            }
+            // A point already in the design continues its replication numbering,
+            // so the new runs add information instead of repeating its streams
+            int existing = data.findPoint(point);
+            int number = existing >= 0 ? data.point_numbers[existing] : data.next_point;
+            int first = existing >= 0 ? data.counts[existing] : 0;
+            vector<vector<double>> outputs(replications);
+            runParallel(replications, [&](int r) {
+                outputs[r] = runDesignPoint(base, factors, point, first + r, warmup, horizon);
+            });
+            vector<double> values;
+            for (const auto& run : outputs) values.push_back(run[output_index]);
+
+            ofstream out(csv_path, ios::app);
+            out << setprecision(10);
+            for (int r = 0; r < replications; r++) {
+                out << number << "," << first + r;
+                for (double value : point) out << "," << value;
+                for (double value : outputs[r]) out << "," << value;
+                out << "\n";
+            }
+            data.addRuns(number, point, values);
+            shared_ptr<GaussianProcess> refitted(new GaussianProcess(*getModel()));
+            if (refitted->fit(data, false)) {
+                lock_guard<mutex> lock(model_mutex);
+                model = refitted;
+            }
+            num_simulated++;
+            lock_guard<mutex> lock(queue_mutex);
+            queued.erase(point);
+        }
+    }
+
+    string answer(const string& request) {
+        stringstream stream(request);
+        string command;
+        stream >> command;
+        ostringstream reply;
+        if (command == "predict") {
+            vector<double> point;
+            for (double value; stream >> value;) point.push_back(value);
+            if (point.size() != data.factor_names.size()) {
+                return "error expected " + to_string(data.factor_names.size()) + " factor values";
+            }
+            double mean, sd;
+            getModel()->predict(point, mean, sd);
+            num_queries++;
+            reply << "ok " << setprecision(6) << mean << " " << sd;
+            if (sd > max_sd && can_simulate && isSimulable(point)) {
+                lock_guard<mutex> lock(queue_mutex);
+                if (queued.insert(point).second) {
+                    pending.push_back(point);
+                    queue_ready.notify_one();
+                }
+                reply << " simulating";
+            }
+        }
+        else if (command == "info") {
+            reply << "ok " << getModel()->getPoints() << " " << output_name;
+            for (const auto& name : data.factor_names) reply << " " << name;
+        }
+        else if (command == "shutdown") {
+            reply << "ok"; // the server stops once the reply is sent
+        }
+        else {
+            reply << "error unknown command " << command;
+        }
+        return reply.str();
+    }
+
+    // Positive intervals and service times, an integer buffer of at least 1
+    bool isSimulable(const vector<double>& point) const {
+        for (size_t k = 0; k < point.size(); k++) {
+            if (point[k] <= 0) return false;
+            if (factors[k].kind == DesignFactor::BUFFER && point[k] != floor(point[k])) return false;
+        }
+        return true;
+    }
+
+    void serveClient(int id, int fd) {
+        string buffer;
+        char chunk[4096];
+        while (true) {
+            size_t end = buffer.find('\n');
+            if (end == string::npos) {
+                ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+                if (received <= 0) break;
+                buffer.append(chunk, received);
+                continue;
+            }
+            string request = buffer.substr(0, end);
+            string reply = answer(request) + "\n";
+            buffer.erase(0, end + 1);
+            if (send(fd, reply.data(), reply.size(), MSG_NOSIGNAL) < 0) break;
+            string command;
+            stringstream(request) >> command;
+            if (command == "shutdown") stop();
+        }
+        // Closed under the lock, so stop() never shuts down a reused descriptor
+        lock_guard<mutex> lock(clients_mutex);
+        client_fds.erase(id);
+        close(fd);
+        finished_clients.push_back(id);
+    }
+
+public:
+    MetamodelServer(const ModelConfig& config, double spread, const string& path, const string& output,
+        double sd_threshold, int num_replications, double warmup_time, double horizon_time)
+        : base(config), factors(makeDesignFactors(config, spread)), can_simulate(false), csv_path(path),
+        output_name(output), output_index(0), max_sd(sd_threshold), replications(num_replications),
+        warmup(warmup_time), horizon(horizon_time), stopping(false), num_queries(0), num_simulated(0),
+        listen_fd(-1) {
+        vector<string> names = getDesignOutputNames(config);
+        output_index = (int)(find(names.begin(), names.end(), output) - names.begin());
+        base.engine = ENGINE_XOSHIRO;
+        base.prefetch = false;
+    }
+
+    bool run(const string& socket_path) {
+        cout << "=== METAMODEL SERVER ===" << endl;
+        GaussianProcess fitted;
+        if (!loadMetamodel(csv_path, output_name, data, fitted)) return false;
+        model.reset(new GaussianProcess(fitted));
+        can_simulate = factors.size() == data.factor_names.size() &&
+            output_index < (int)getDesignOutputNames(base).size();
+        for (size_t k = 0; can_simulate && k < factors.size(); k++) {
+            can_simulate = factors[k].getName() == data.factor_names[k];
+        }
+        if (!can_simulate) {
+            cout << "CSV factors differ from this configuration: no background simulations" << endl;
+        }
+        else if (base.seed == 0) {
+            can_simulate = false;
+            cout << "No --seed (the design's seed): no background simulations" << endl;
+        }
+
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            cout << "Socket path too long: " << socket_path << endl;
+            return false;
+        }
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0) {
+            cout << "Cannot create socket " << socket_path << ": " << strerror(errno) << endl;
+            return false;
+        }
+        strcpy(address.sun_path, socket_path.c_str());
+        unlink(socket_path.c_str());
+        if (bind(listen_fd, (sockaddr*)&address, sizeof(address)) < 0 || listen(listen_fd, 16) < 0) {
+            cout << "Cannot listen on " << socket_path << ": " << strerror(errno) << endl;
+            close(listen_fd);
+            return false;
+        }
+        cout << "Listening on " << socket_path << " (sd above " << setprecision(4) << max_sd << " triggers "
+            << replications << " replications, horizon " << setprecision(0) << horizon << ")" << endl;
+
+        thread simulator([this]() { simulatePending(); });
+        int next_client = 0;
+        while (!stopping) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            joinFinishedClients();
+            lock_guard<mutex> lock(clients_mutex);
+            if (stopping) {
+                close(fd);
+                break;
+            }
+            int id = next_client++;
+            client_fds[id] = fd;
+            clients[id] = thread([this, id, fd]() { serveClient(id, fd); });
+        }
+        stop();
+        {
+            // The simulation thread either waits already or sees stopping
+            lock_guard<mutex> lock(queue_mutex);
+        }
+        queue_ready.notify_all();
+        simulator.join();
+        for (auto& client : clients) client.second.join();
+        close(listen_fd);
+        unlink(socket_path.c_str());
+        cout << num_queries << " predictions answered, " << num_simulated << " points simulated, "
+            << getModel()->getPoints() << " points in the metamodel" << endl;
+        return true;
+    }
+};
+
+// Query client (--query SOCKET): sends every line of standard input to the
+// server and prints the replies with their round-trip times
+void queryMetamodel(const string& socket_path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+        cout << "Cannot connect to " << socket_path << endl;
+        if (fd >= 0) close(fd);
+        return;
+    }
+    string line, buffer;
+    char chunk[4096];
+    double total_us = 0;
+    int count = 0;
+    while (getline(cin, line)) {
+        if (line.empty()) continue;
+        auto t0 = chrono::steady_clock::now();
+        line += "\n";
+        if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) < 0) break;
+        size_t end;
+        while ((end = buffer.find('\n')) == string::npos) {
+            ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+            if (received <= 0) break;
+            buffer.append(chunk, received);
+        }
+        if (end == string::npos) break;
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+        total_us += us;
+        count++;
+        cout << buffer.substr(0, end) << "  (" << fixed << setprecision(1) << us << " us)" << endl;
+        buffer.erase(0, end + 1);
+    }
+    close(fd);
+    if (count > 0) cout << count << " queries, mean round trip " << total_us / count << " us" << endl;
+}
+#endif
+
+// One row of the phase-type table: the fit against the sample moments and CDF
+void printPhaseTypeRow(const string& source, const string& method, const PhaseType* fit,
+    const vector<double>& sorted, double sample_third) {
+    double mean, scv, third_error = 0, ks = 0;
+    if (fit) {
+        mean = fit->getMoment(1);
+        scv = fit->getMoment(2) / (mean * mean) - 1;
+        third_error = fit->getMoment(3) / sample_third - 1;
+        ks = ksDistance(*fit, sorted);
+    }
+    else {
+        double sum = 0, sq_sum = 0;
+        for (double x : sorted) {
+            sum += x;
+            sq_sum += x * x;
+        }
+        mean = sum / sorted.size();
+        scv = (sq_sum / sorted.size()) / (mean * mean) - 1;
+    }
+    cout << setw(8) << source << setw(10) << method << setw(8) << (fit ? to_string(fit->getPhases()) : "-")
+        << setw(10) << fixed << setprecision(4) << mean << setw(10) << scv;
+    if (fit) {
+        cout << setw(11) << setprecision(2) << 100 * third_error << "%" << setw(10) << setprecision(4) << ks;
+    }
+    cout << endl;
+}
+
+// Phase-type fitting mode (--ph-fit): PH representations of every source's
+// interarrival distribution, by moment matching of its configured moments and
+// by EM on a trace simulated with the model's own sampler, or of the intervals
+// of a trace file (--ph-trace); errors are measured against the samples
+void runPhaseTypeFit(ModelConfig config, const string& trace_path, int max_phases, int num_samples) {
+    config.seed = config.resolveSeed();
+    vector<string> names;
+    vector<vector<double>> traces;
+    vector<double> means, scvs;
+
+    if (!trace_path.empty()) {
+        ifstream file(trace_path);
+        vector<double> trace;
+        double x;
+        while (file >> x) {
+            if (x > 0) trace.push_back(x);
+        }
+        if (trace.size() < 2) {
+            cout << "Trace " << trace_path << ": fewer than two positive intervals" << endl;
+            return;
+        }
+        double sum = 0, sq_sum = 0;
+        for (double value : trace) {
+            sum += value;
+            sq_sum += value * value;
+        }
+        double mean = sum / trace.size();
+        names.push_back("trace");
+        traces.push_back(trace);
+        means.push_back(mean);
+        scvs.push_back(sq_sum / trace.size() / (mean * mean) - 1);
+        cout << "=== PHASE-TYPE FITTING (" << trace.size() << " intervals from " << trace_path
+            << ", EM up to " << max_phases << " phases) ===" << endl;
+    }
+    else {
+        for (int i = 0; i < config.getNumSources(); i++) {
+            double a = config.source_min_intervals[i], b = config.source_max_intervals[i];
+            Xoshiro256PlusPlus stream = StreamFactory<Xoshiro256PlusPlus>::make(config.seed, config.replication, i);
+            BasicSource<Xoshiro256PlusPlus> source(i, a, b, stream, config.sampler, config.arrivals);
+            vector<double> trace(num_samples);
+            for (double& x : trace) x = source.getNextInterval();
+            names.push_back("S" + to_string(i + 1));
+            traces.push_back(trace);
+            means.push_back((a + b) / 2);
+            scvs.push_back(config.arrivals == ARRIVALS_EXPONENTIAL ? 1.0 : (b - a) * (b - a) / (3 * (a + b) * (a + b)));
+        }
+        cout << "=== PHASE-TYPE FITTING (" << num_samples << " simulated intervals per source, seed "
+            << config.seed << ", EM up to " << max_phases << " phases) ===" << endl;
+    }
+
+    cout << setw(8) << "Source" << setw(10) << "Fit" << setw(8) << "Phases" << setw(10) << "Mean"
+        << setw(10) << "SCV" << setw(12) << "M3 error" << setw(10) << "KS" << endl;
+    vector<string> descriptions;
+    for (size_t i = 0; i < traces.size(); i++) {
+        vector<double> sorted(traces[i]);
+        sort(sorted.begin(), sorted.end());
+        double third = 0;
+        for (double x : sorted) third += x * x * x;
+        third /= sorted.size();
+
+        PhaseType moments = fitPhaseTypeMoments(means[i], scvs[i]);
+        double log_likelihood = 0;
+        PhaseType em = fitPhaseTypeEm(traces[i], max_phases, log_likelihood);
+
+        printPhaseTypeRow(names[i], "sample", nullptr, sorted, third);
+        printPhaseTypeRow(names[i], "moments", &moments, sorted, third);
+        printPhaseTypeRow(names[i], "EM", &em, sorted, third);
+        descriptions.push_back(names[i] + " moments: " + moments.getDescription());
+        ostringstream em_text;
+        em_text << names[i] << " EM: " << em.getDescription() << ", log-likelihood "
+            << fixed << setprecision(1) << log_likelihood;
+        descriptions.push_back(em_text.str());
+    }
+    cout << "\n--- REPRESENTATIONS ---" << endl;
+    for (const string& text : descriptions) cout << text << endl;
+}
+
+// Runs the selected model with the engine chosen in the configuration
+template <typename Engine>
+void runModel(const ModelConfig& config, bool streaming) {
+    if (streaming) {
+        ScopedTrace construction_trace("construction");
+        BasicStreamingModel<Engine> model(config);
+        construction_trace.finish();
+        model.run(1000.0, 1000);
+    }
+    else {
+        ScopedTrace construction_trace("construction");
+        BasicSimulationModel<Engine> model(config);
+        construction_trace.finish();
+        model.run(1000.0, 1000);
+    }
+}
+
+// Numeric value of an option: false, with a message naming the option, when
+// the text is not a number (an integer for integral T) in [low, high]
+template <typename T>
+bool parseOption(const string& option, const string& text, T low, T high, T& value) {
+    const char* begin = text.c_str();
+    char* end = nullptr;
+    errno = 0;
+    double parsed = strtod(begin, &end);
+    bool valid = end != begin && *end == '\0' && errno != ERANGE && parsed >= low && parsed <= high &&
+        (!is_integral<T>::value || parsed == floor(parsed));
+    if (!valid) {
+        cout << "Invalid value for " << option << ": \"" << text << "\" (expected "
+            << (is_integral<T>::value ? "an integer" : "a number");
+        if (!is_integral<T>::value && low == numeric_limits<T>::min()) {
+            cout << " > 0"; // smallest positive value: positive numbers
+        }
+        else {
+            cout << " >= " << low;
+        }
+        if (high != numeric_limits<T>::max()) cout << " and <= " << high;
+        cout << ")" << endl;
+        return false;
+    }
+    value = (T)parsed;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    ModelConfig config;
+    bool streaming = false;
+    bool verify_sampler = false;
+    bool bench_rng = false;
+    bool cftp = false;
+    int replications = 16;
+    double warmup = 1000.0;
+    double horizon = 10000.0;
+    bool resimulate = false;
+    ModelConfig changed;
+    bool pareto = false;
+    bool check_allocations = false;
+    bool bench_reset = false;
+    int interleave_models = 0;
+    bool codegen = false;
+    string codegen_cache = "codegen_cache";
+    bool tau_leap = false;
+    double tau_epsilon = 0.03;
+    bool fluid = false;
+    bool qbd = false;
+    bool ph_fit = false;
+    string ph_trace;
+    int ph_phases = 8;
+    int ph_samples = 20000;
+    string doe_method;
+    int doe_points = 64;
+    double doe_spread = 0.5;
+    string doe_out = "doe.csv";
+    bool sensitivity = false;
+    int sensitivity_samples = 64;
+    string sensitivity_output = "reject";
+    int bootstrap = 1000;
+    string metamodel_path;
+    string metamodel_output = "reject";
+    string serve_socket;
+    double max_sd = 0.01;
+    string query_socket;
+    double fluid_step = 0.05;
+    double load_amplitude = 0.0;
+    double load_period = 0.0;
+    string trace_path;
+    string objective_spec = "devices,reject1,wait3";
+    int sweep_devices = 4;
+    int sweep_buffer = 6;
+
+    // Options: --stream (statistics-only streaming mode), --seed N (fixed seed),
+    // --sampler std|ziggurat, --verify-sampler (statistical test of the samplers),
+    // --engine default|xoshiro|pcg, --replication N, --bench-rng (engine benchmark),
+    // --prefetch (variates generated by a producer thread), --arrivals uniform|exponential,
+    // --buffer N (buffer size), --resimulate buffer=N|deviceJ=T (incremental re-simulation
+    // of a changed configuration, may be repeated),
+    // --cftp (perfect sampling against warm-up), --replications N, --warmup T, --horizon T,
+    // --pareto (device count x buffer size sweep), --objectives devices,buffer,rejectK,waitK,totalK,
+    // --sweep-devices N, --sweep-buffer N, --window T (rate window length), --window-buckets K,
+    // --perf (hardware counters per event in run() and --bench-rng, Linux),
+    // --check-allocations (steady state must not allocate; ALLOCATION_ACCOUNTING build),
+    // --trace FILE (Chrome trace-event JSON of wall-clock phases per thread),
+    // --bench-reset (replication setup: new model against reset in place),
+    // --bench-interleave N (N different models advanced round-robin by one thread),
+    // --codegen (compiled specialized model, Linux; needs --engine xoshiro),
+    // --codegen-cache DIR (shared objects cached by configuration hash),
+    // --tau-leap (approximate aggregated engine over --horizon), --tau-epsilon E,
+    // --devices N, --arrival-scale X (arrival rates multiplied by X),
+    // --fluid (fluid approximation against the event model over --horizon), --fluid-step H,
+    // --load-amplitude A, --load-period P (time-varying load of the fluid model),
+    // --qbd (matrix-analytic solution of the exponential variant against the event model),
+    // --ph-fit (phase-type fits of the interarrival distributions), --ph-trace FILE
+    // (fit the intervals in FILE instead), --ph-phases N (EM size), --ph-samples N,
+    // --doe lhs|sobol (design of experiments, --replications per point), --doe-points N,
+    // --doe-spread X (factors within 1 +- X times their base value), --doe-out FILE (CSV),
+    // --sensitivity (Sobol indices over the --doe-spread factors), --sensitivity-samples N,
+    // --sensitivity-output reject|reject_SK|wait_SK|util_DK, --bootstrap N,
+    // --metamodel FILE (Gaussian process fitted to a --doe CSV, validated), --metamodel-output NAME,
+    // --serve SOCKET (what-if queries on a Unix socket, with --metamodel; Linux), --max-sd X
+    // (prediction sd that triggers a background simulation; needs the design's --seed),
+    // --query SOCKET (client, stdin lines)
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--stream") {
+            streaming = true;
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 0u, UINT_MAX, config.seed)) return 1;
+        }
+        else if (arg == "--sampler" && i + 1 < argc) {
+            string name = argv[++i];
+            config.sampler = (name == "ziggurat") ? SAMPLER_ZIGGURAT : SAMPLER_STD;
+        }
+        else if (arg == "--verify-sampler") {
+            verify_sampler = true;
+        }
+        else if (arg == "--engine" && i + 1 < argc) {
+            string name = argv[++i];
+            config.engine = (name == "xoshiro") ? ENGINE_XOSHIRO :
+                (name == "pcg") ? ENGINE_PCG : ENGINE_DEFAULT;
+        }
+        else if (arg == "--replication" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 0, INT_MAX, config.replication)) return 1;
+        }
+        else if (arg == "--bench-rng") {
+            bench_rng = true;
+        }
+        else if (arg == "--prefetch") {
+            config.prefetch = true;
+        }
+        else if (arg == "--arrivals" && i + 1 < argc) {
+            string name = argv[++i];
+            config.arrivals = (name == "exponential") ? ARRIVALS_EXPONENTIAL : ARRIVALS_UNIFORM;
+        }
+        else if (arg == "--buffer" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 1, INT_MAX, config.buffer_size)) return 1;
+        }
+        else if (arg == "--resimulate" && i + 1 < argc) {
+            string change = argv[++i];
+            size_t eq = change.find('=');
+            if (eq == string::npos) continue;
+            string key = change.substr(0, eq);
+            string value = change.substr(eq + 1);
+            if (!resimulate) {
+                changed = config;
+                resimulate = true;
+            }
+            if (key == "buffer") {
+                if (!parseOption(arg, value, 1, INT_MAX, changed.buffer_size)) return 1;
+            }
+            else if (key.compare(0, 6, "device") == 0) {
+                int device_id;
+                double mean_time;
+                if (!parseOption(arg, key.substr(6), 1, changed.getNumDevices(), device_id) ||
+                    !parseOption(arg, value, numeric_limits<double>::min(), numeric_limits<double>::max(), mean_time)) {
+                    return 1;
+                }
+                changed.device_mean_times[device_id - 1] = mean_time;
+            }
+        }
+        else if (arg == "--cftp") {
+            cftp = true;
+        }
+        else if (arg == "--replications" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 1, INT_MAX, replications)) return 1;
+        }
+        else if (arg == "--warmup" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 0.0, numeric_limits<double>::max(), warmup)) return 1;
+        }
+        else if (arg == "--horizon" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], numeric_limits<double>::min(), numeric_limits<double>::max(), horizon)) return 1;
+        }
+        else if (arg == "--window" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], numeric_limits<double>::min(), numeric_limits<double>::max(), config.window_length)) return 1;
+        }
+        else if (arg == "--window-buckets" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 1, INT_MAX, config.window_buckets)) return 1;
+        }
+        else if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+            trace_recorder.enable();
+        }
+        else if (arg == "--bench-interleave" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 1, INT_MAX, interleave_models)) return 1;
+        }
+        else if (arg == "--doe" && i + 1 < argc) {
+            doe_method = argv[++i];
+        }
+        else if (arg == "--doe-points" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 1, INT_MAX, doe_points)) return 1;
+        }
+        else if (arg == "--doe-spread" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 0.0, 0.95, doe_spread)) return 1;
+        }
+        else if (arg == "--doe-out" && i + 1 < argc) {
+            doe_out = argv[++i];
+        }
+        else if (arg == "--sensitivity") {
+            sensitivity = true;
+        }
+        else if (arg == "--sensitivity-samples" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 2, INT_MAX, sensitivity_samples)) return 1;
+        }
+        else if (arg == "--sensitivity-output" && i + 1 < argc) {
+            sensitivity_output = argv[++i];
+        }
+        else if (arg == "--bootstrap" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 1, INT_MAX, bootstrap)) return 1;
+        }
+        else if (arg == "--metamodel" && i + 1 < argc) {
+            metamodel_path = argv[++i];
+        }
+        else if (arg == "--metamodel-output" && i + 1 < argc) {
+            metamodel_output = argv[++i];
+        }
+        else if (arg == "--serve" && i + 1 < argc) {
+            serve_socket = argv[++i];
+        }
+        else if (arg == "--max-sd" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 0.0, numeric_limits<double>::max(), max_sd)) return 1;
+        }
+        else if (arg == "--query" && i + 1 < argc) {
+            query_socket = argv[++i];
+        }
+        else if (arg == "--ph-fit") {
+            ph_fit = true;
+        }
+        else if (arg == "--ph-trace" && i + 1 < argc) {
+            ph_fit = true;
+            ph_trace = argv[++i];
+        }
+        else if (arg == "--ph-phases" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 1, 1000, ph_phases)) return 1;
+        }
+        else if (arg == "--ph-samples" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 2, INT_MAX, ph_samples)) return 1;
+        }
+        else if (arg == "--qbd") {
+            qbd = true;
+        }
+        else if (arg == "--fluid") {
+            fluid = true;
+        }
+        else if (arg == "--fluid-step" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], numeric_limits<double>::min(), numeric_limits<double>::max(), fluid_step)) return 1;
+        }
+        else if (arg == "--load-amplitude" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 0.0, 1.0, load_amplitude)) return 1;
+        }
+        else if (arg == "--load-period" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 0.0, numeric_limits<double>::max(), load_period)) return 1;
+        }
+        else if (arg == "--tau-leap") {
+            tau_leap = true;
+        }
+        else if (arg == "--tau-epsilon" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], numeric_limits<double>::min(), 1.0, tau_epsilon)) return 1;
+        }
+        else if (arg == "--devices" && i + 1 < argc) {
+            int num_devices;
+            if (!parseOption(arg, argv[++i], 1, INT_MAX, num_devices)) return 1;
+            config.setNumDevices(num_devices);
+        }
+        else if (arg == "--arrival-scale" && i + 1 < argc) {
+            double scale;
+            if (!parseOption(arg, argv[++i], numeric_limits<double>::min(), numeric_limits<double>::max(), scale)) {
+                return 1;
+            }
+            for (double& interval : config.source_min_intervals) interval /= scale;
+            for (double& interval : config.source_max_intervals) interval /= scale;
+        }
+        else if (arg == "--codegen") {
+            codegen = true;
+        }
+        else if (arg == "--codegen-cache" && i + 1 < argc) {
+            codegen_cache = argv[++i];
+        }
+        else if (arg == "--bench-reset") {
+            bench_reset = true;
+        }
+        else if (arg == "--check-allocations") {
+            check_allocations = true;
+        }
+        else if (arg == "--perf") {
+            config.perf_counters = true;
+        }
+        else if (arg == "--pareto") {
+            pareto = true;
+        }
+        else if (arg == "--objectives" && i + 1 < argc) {
+            objective_spec = argv[++i];
+        }
+        else if (arg == "--sweep-devices" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 1, INT_MAX, sweep_devices)) return 1;
+        }
+        else if (arg == "--sweep-buffer" && i + 1 < argc) {
+            if (!parseOption(arg, argv[++i], 1, INT_MAX, sweep_buffer)) return 1;
+        }
+    }
+
+    if (verify_sampler) {
+        return verifySamplers(config.resolveSeed()) ? 0 : 1;
+    }
+    if (bench_rng) {
+        benchmarkEngines(config);
+        return 0;
+    }
+    if (cftp) {
+        comparePerfectSampling(config, replications, warmup, horizon);
+        writeTrace(trace_path);
+        return 0;
+    }
+    if (!query_socket.empty() || !serve_socket.empty()) {
+#ifdef __linux__
+        if (!query_socket.empty()) {
+            queryMetamodel(query_socket);
+            return 0;
+        }
+        if (metamodel_path.empty()) {
+            cout << "--serve needs --metamodel FILE" << endl;
+            return 1;
+        }
+        MetamodelServer server(config, doe_spread, metamodel_path, metamodel_output, max_sd,
+            replications, warmup, horizon);
+        return server.run(serve_socket) ? 0 : 1;
+#else
+        cout << "--serve and --query need Unix domain sockets (Linux build)" << endl;
+        return 1;
+#endif
+    }
+    if (!metamodel_path.empty()) {
+        runMetamodel(metamodel_path, metamodel_output);
+        return 0;
+    }
+    if (sensitivity) {
+        runSensitivity(config, sensitivity_samples, doe_spread, sensitivity_output, bootstrap,
+            replications, warmup, horizon);
+        writeTrace(trace_path);
+        return 0;
+    }
+    if (!doe_method.empty()) {
+        if (doe_method != "lhs" && doe_method != "sobol") {
+            cout << "Unknown design: " << doe_method << endl;
+            return 1;
+        }
+        runDesign(config, doe_method, doe_points, doe_spread, doe_out, replications, warmup, horizon);
+        writeTrace(trace_path);
+        return 0;
+    }
+    if (ph_fit) {
+        runPhaseTypeFit(config, ph_trace, ph_phases, ph_samples);
+        return 0;
+    }
+    if (qbd) {
+        runQbd(config, horizon);
+        return 0;
+    }
+    if (fluid) {
+        compareFluid(config, horizon, fluid_step, load_amplitude, load_period);
+        return 0;
+    }
+    if (tau_leap) {
+        runTauLeap(config, horizon, tau_epsilon);
+        return 0;
+    }
+    if (codegen) {
+        runSpecialized(config, codegen_cache, replications, horizon);
+        return 0;
+    }
+    if (interleave_models > 0) {
+        benchmarkInterleave(config, interleave_models);
+        return 0;
+    }
+    if (bench_reset) {
+        benchmarkReset(config);
+        return 0;
+    }
+    if (check_allocations) {
+        bool ok;
+        if (config.engine == ENGINE_XOSHIRO) {
+            ok = checkAllocations<Xoshiro256PlusPlus>(config, warmup, horizon);
+        }
+        else if (config.engine == ENGINE_PCG) {
+            ok = checkAllocations<Pcg64>(config, warmup, horizon);
+        }
+        else {
+            ok = checkAllocations<default_random_engine>(config, warmup, horizon);
+        }
+        return ok ? 0 : 1;
+    }
+    if (pareto) {
+        vector<Objective> objectives;
+        if (!parseObjectives(objective_spec, config.getNumSources(), objectives)) {
+            cout << "Unknown objective list: " << objective_spec << endl;
+            return 1;
+        }
+        config.engine = ENGINE_XOSHIRO;
+        config.prefetch = false;
+        config.seed = config.resolveSeed();
+        ParetoSweep sweep(objectives, warmup, horizon);
+        sweep.run(config, sweep_devices, sweep_buffer, replications, 0.05, 3);
+        writeTrace(trace_path);
+        return 0;
+    }
+    if (resimulate) {
+        // Options given after --resimulate apply to the base configuration only
+        changed.seed = config.seed;
+        changed.engine = config.engine;
+        changed.sampler = config.sampler;
+        changed.arrivals = config.arrivals;
+        changed.replication = config.replication;
+        if (config.engine == ENGINE_XOSHIRO) {
+            compareIncremental<Xoshiro256PlusPlus>(config, changed, horizon);
+        }
+        else if (config.engine == ENGINE_PCG) {
+            compareIncremental<Pcg64>(config, changed, horizon);
+        }
+        else {
+            compareIncremental<default_random_engine>(config, changed, horizon);
+        }
+        return 0;
+    }
+
+    if (config.engine == ENGINE_XOSHIRO) {
+        runModel<Xoshiro256PlusPlus>(config, streaming);
+    }
+    else if (config.engine == ENGINE_PCG) {
+        runModel<Pcg64>(config, streaming);
+    }
+    else {
+        runModel<default_random_engine>(config, streaming);
+    }
+    writeTrace(trace_path);
 
     cout << "\nPress Enter to exit...";
     cin.get();
 
     return 0;
-}
\ No newline at end of file
+}